@@ -18,6 +18,16 @@ typedef struct font_char
   uint16_t  offset;	/**< Character offset in bitmap array. */
 } FONT_CHAR;
 
+/**
+*	\brief	Run of codepoints with glyphs in a row.
+*/
+typedef struct font_range
+{
+  uint32_t first;	/**< First codepoint of the run. */
+  uint16_t count;	/**< Codepoints in the run. */
+  uint16_t glyph;	/**< Glyph of the first codepoint. */
+} FONT_RANGE;
+
 /**
 *	\brief	Font struct.
 */
@@ -26,6 +36,8 @@ typedef struct font
 	uint8_t Heigth;				/**< Characters heigth. */
 	const FONT_CHAR* FontChar;	/**< Characters descriptor array. */
 	const uint8_t* Bitmap;		/**< Character bitmap array */
+	const FONT_RANGE* Ranges;	/**< Codepoint runs sorted by first, NULL for the CP1251 layout. */
+	uint16_t RangeCount;		/**< Runs in the Ranges array. */
 } FONT;
 
 /* Font data for Times New Roman 16pt */
@@ -4202,6 +4202,15 @@ const FONT_CHAR timesNewRoman_16ptDescriptors[] =
 };
 
 
+/* Codepoints of the glyphs, { [First codepoint], [Codepoints], [First glyph] } */
+const FONT_RANGE timesNewRoman_16ptRanges[] = 
+{
+	{0x0020, 95, 0}, 		/* ' ' - '~' */ 
+	{0x0401, 1, 95}, 		/*  */ 
+	{0x0410, 64, 96}, 		/*  -  */ 
+	{0x0451, 1, 160}, 		/*  */ 
+};
+
 /* Font information for Times New Roman 16pt */
 const FONT timesNewRoman_16ptFont =
 {
@@ -4210,5 +4219,7 @@ const FONT timesNewRoman_16ptFont =
 	//'', /*  End character */
 	(const FONT_CHAR*)timesNewRoman_16ptDescriptors, /*  Character descriptor array */
 	(const uint8_t*)timesNewRoman_16ptBitmaps, /*  Character bitmap array */
+	timesNewRoman_16ptRanges, /*  Codepoint ranges */
+	sizeof(timesNewRoman_16ptRanges) / sizeof(timesNewRoman_16ptRanges[0]),
 };
 
@@ -8,6 +8,13 @@
  */
 
 #include "LibGP.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define LIB_GP_PRINT_DEBUG
 #ifdef LIB_GP_PRINT_DEBUG
@@ -46,7 +53,7 @@ void GP_SetPixelRotate(uint16_t x,
                        uint32_t w,
                        uint32_t h)
 {
-  Buffer += (w - x + w * (h - y));
+  Buffer += ((w - 1 - x) + w * (h - 1 - y));
   *Buffer = color;
 }
 
@@ -73,7 +80,7 @@ uint16_t GP_GetColorRotate(uint16_t x,
                            uint32_t w,
                            uint32_t h)
 {
-  Buffer += (800 - x + w * (600 - y));
+  Buffer += ((w - 1 - x) + w * (h - 1 - y));
   return *Buffer;
 }
 
@@ -94,6 +101,331 @@ void GP_RotateScreen()
   }
 }
 
+/**
+ *	Span kernel. Every span based primitive ends up here: one clipped
+ *	horizontal run of pixels is written straight into the video buffer
+ *	instead of going through pGP_SetPixel for each pixel.
+ */
+
+#define GP_FIX_SHIFT 8                      /**< Subpixel bits of fixed point coordinates. */
+#define GP_FIX_ONE (1 << GP_FIX_SHIFT)      /**< 1.0 in fixed point. */
+#define GP_FIX_HALF (1 << (GP_FIX_SHIFT - 1))
+
+#define GP_CONVEX_MAX 8                     /**< Max vertices of a convex polygon. */
+#define GP_BATCH_BAND 16                    /**< Rows swept at once by batches. */
+#define GP_SHAPE_BAND 64                    /**< Rows swept by line and circle batches. */
+#define GP_BATCH_MAX 128                    /**< Items of a batch sorted at once. */
+#define GP_BATCH_BANDS 128                  /**< Bands sorted at once. */
+
+#define GP_CIRCLE_CACHE_SIZE 8              /**< Cached circle octants. */
+#define GP_CIRCLE_CACHE_MAX_R 127           /**< Max radius of a cached octant. */
+#define GP_CIRCLE_OCTANT_MAX 96             /**< Offsets in one octant of GP_CIRCLE_CACHE_MAX_R. */
+#define GP_OCTANTS_NE 0x03
+#define GP_OCTANTS_SE 0x0C
+#define GP_OCTANTS_SW 0x30
+#define GP_OCTANTS_NW 0xC0
+
+#ifndef GP_CURVE_TOLERANCE
+#define GP_CURVE_TOLERANCE (GP_FIX_ONE / 4) /**< Max distance of flattened curves, fixed point. */
+#endif
+
+static inline bool GP_IsRotated(void)
+{
+  return pGP_SetPixel == GP_SetPixelRotate;
+}
+
+static void GP_FillSpan(uint16_t *p, uint32_t n, uint16_t color)
+{
+#if defined(__SSE2__)
+  __m128i c = _mm_set1_epi16((short)color);
+  for (; n >= 16; n -= 16, p += 16) {
+    _mm_storeu_si128((__m128i *)p, c);
+    _mm_storeu_si128((__m128i *)(p + 8), c);
+  }
+  if (n >= 8) {
+    _mm_storeu_si128((__m128i *)p, c);
+    n -= 8;
+    p += 8;
+  }
+#elif defined(__ARM_NEON)
+  uint16x8_t c = vdupq_n_u16(color);
+  for (; n >= 8; n -= 8, p += 8)
+    vst1q_u16(p, c);
+#else
+  uint32_t c2 = ((uint32_t)color << 16) | color;
+  if (n && ((uintptr_t)p & 2)) {
+    *p++ = color;
+    n--;
+  }
+  for (; n >= 8; n -= 8, p += 8) {
+    memcpy(p, &c2, 4);
+    memcpy(p + 2, &c2, 4);
+    memcpy(p + 4, &c2, 4);
+    memcpy(p + 6, &c2, 4);
+  }
+#endif
+  while (n--)
+    *p++ = color;
+}
+
+/* Draws pixels x1..x2 (inclusive) of the row y, clipped to the buffer. */
+static void GP_SetSpanH(int32_t x1,
+                        int32_t x2,
+                        int32_t y,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h)
+{
+  if (y < 0 || y >= (int32_t)h)
+    return;
+  if (x1 < 0)
+    x1 = 0;
+  if (x2 >= (int32_t)w)
+    x2 = (int32_t)w - 1;
+  if (x1 > x2)
+    return;
+
+  if (GP_IsRotated())
+    GP_FillSpan(Buffer + (w - 1 - x2) + w * (h - 1 - y), x2 - x1 + 1, color);
+  else
+    GP_FillSpan(Buffer + x1 + w * y, x2 - x1 + 1, color);
+}
+
+static inline uint16_t *GP_PixelPtr(int32_t x,
+                                    int32_t y,
+                                    uint16_t *Buffer,
+                                    uint32_t w,
+                                    uint32_t h)
+{
+  if (GP_IsRotated())
+    return Buffer + (w - 1 - x) + w * (h - 1 - y);
+  return Buffer + x + w * y;
+}
+
+/* Draws pixels y1..y2 (inclusive) of the column x, clipped to the buffer. */
+static void GP_SetSpanV(int32_t x,
+                        int32_t y1,
+                        int32_t y2,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h)
+{
+  if (x < 0 || x >= (int32_t)w)
+    return;
+  if (y1 < 0)
+    y1 = 0;
+  if (y2 >= (int32_t)h)
+    y2 = (int32_t)h - 1;
+  if (y1 > y2)
+    return;
+
+  uint16_t *p = GP_PixelPtr(x, GP_IsRotated() ? y2 : y1, Buffer, w, h);
+  for (int32_t n = y2 - y1 + 1; n > 0; n--, p += w)
+    *p = color;
+}
+
+/*
+ * Bresenham line with the same pixels as GP_SetBresenhamLine. Writes through
+ * a stepped pointer when the line is on screen, clips per pixel otherwise.
+ */
+static void GP_SetLineClipped(int32_t x0,
+                              int32_t y0,
+                              int32_t x1,
+                              int32_t y1,
+                              uint16_t color,
+                              uint16_t *Buffer,
+                              uint32_t w,
+                              uint32_t h)
+{
+  int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int32_t dy = abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int32_t err = (dx > dy ? dx : -dy) / 2, e2;
+
+  if (x0 >= 0 && x1 >= 0 && y0 >= 0 && y1 >= 0 && x0 < (int32_t)w &&
+      x1 < (int32_t)w && y0 < (int32_t)h && y1 < (int32_t)h) {
+    int32_t step = GP_IsRotated() ? -1 : 1;
+    int32_t px = sx * step, py = sy * step * (int32_t)w;
+    uint16_t *p = GP_PixelPtr(x0, y0, Buffer, w, h);
+    for (;;) {
+      *p = color;
+      if (x0 == x1 && y0 == y1)
+        break;
+      e2 = err;
+      if (e2 > -dx) {
+        err -= dy;
+        x0 += sx;
+        p += px;
+      }
+      if (e2 < dy) {
+        err += dx;
+        y0 += sy;
+        p += py;
+      }
+    }
+    return;
+  }
+
+  for (;;) {
+    if (x0 >= 0 && y0 >= 0 && x0 < (int32_t)w && y0 < (int32_t)h)
+      *GP_PixelPtr(x0, y0, Buffer, w, h) = color;
+    if (x0 == x1 && y0 == y1)
+      break;
+    e2 = err;
+    if (e2 > -dx) {
+      err -= dy;
+      x0 += sx;
+    }
+    if (e2 < dy) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+static uint32_t GP_Isqrt(uint64_t v)
+{
+  uint64_t r = 0;
+  uint64_t b = (uint64_t)1 << 62;
+
+  while (b > v)
+    b >>= 2;
+  while (b) {
+    if (v >= r + b) {
+      v -= r + b;
+      r = (r >> 1) + b;
+    } else {
+      r >>= 1;
+    }
+    b >>= 2;
+  }
+  return (uint32_t)r;
+}
+
+/* Blends two RGB 565 colors, alpha 255 gives fg. */
+static inline uint16_t GP_Blend565(uint16_t bg, uint16_t fg, uint8_t alpha)
+{
+  uint32_t a = ((uint32_t)alpha + 4) >> 3;
+  uint32_t b32 = (bg | ((uint32_t)bg << 16)) & 0x07E0F81F;
+  uint32_t f32 = (fg | ((uint32_t)fg << 16)) & 0x07E0F81F;
+  uint32_t r = ((((f32 - b32) * a) >> 5) + b32) & 0x07E0F81F;
+
+  return (uint16_t)((r >> 16) | r);
+}
+
+/* Blends one pixel, clipped to the buffer. */
+static void GP_BlendPixel(int32_t x,
+                          int32_t y,
+                          uint16_t color,
+                          uint8_t alpha,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  uint16_t *p;
+
+  if (x < 0 || y < 0 || x >= (int32_t)w || y >= (int32_t)h || alpha == 0)
+    return;
+  p = GP_PixelPtr(x, y, Buffer, w, h);
+  *p = GP_Blend565(*p, color, alpha);
+}
+
+static inline int32_t GP_FixCeil(int32_t v)
+{
+  return (v + GP_FIX_ONE - 1) >> GP_FIX_SHIFT;
+}
+
+/*
+ * Fills a convex polygon given in fixed point. Pixel (x, y) is covered when
+ * its center (x, y) lies inside, left and top edges are inclusive.
+ */
+static void GP_FillConvexFix(const int32_t *px,
+                             const int32_t *py,
+                             uint8_t n,
+                             uint16_t color,
+                             uint16_t *Buffer,
+                             uint32_t w,
+                             uint32_t h)
+{
+  int32_t ex[GP_CONVEX_MAX], ey0[GP_CONVEX_MAX], ey1[GP_CONVEX_MAX];
+  int64_t slope[GP_CONVEX_MAX];
+  int32_t ymin = py[0], ymax = py[0];
+  uint8_t edges = 0;
+
+  for (uint8_t i = 0; i < n; i++) {
+    int32_t xa = px[i], ya = py[i];
+    int32_t xb = px[(i + 1) % n], yb = py[(i + 1) % n];
+
+    if (ya < ymin)
+      ymin = ya;
+    if (ya > ymax)
+      ymax = ya;
+    if (ya == yb)
+      continue;
+    if (ya > yb) {
+      int32_t t = xa; xa = xb; xb = t;
+      t = ya; ya = yb; yb = t;
+    }
+    ex[edges] = xa;
+    ey0[edges] = ya;
+    ey1[edges] = yb;
+    slope[edges] = (int64_t)(xb - xa) * 65536 / (yb - ya);
+    edges++;
+  }
+
+  int32_t y1 = GP_FixCeil(ymin);
+  int32_t y2 = GP_FixCeil(ymax) - 1;
+  if (y1 < 0)
+    y1 = 0;
+  if (y2 >= (int32_t)h)
+    y2 = (int32_t)h - 1;
+
+  for (int32_t y = y1; y <= y2; y++) {
+    int32_t yc = y << GP_FIX_SHIFT;
+    int32_t l = INT32_MAX, r = INT32_MIN;
+
+    for (uint8_t i = 0; i < edges; i++) {
+      if (yc < ey0[i] || yc >= ey1[i])
+        continue;
+      int32_t x = ex[i] + (int32_t)(((int64_t)(yc - ey0[i]) * slope[i]) >> 16);
+      if (x < l)
+        l = x;
+      if (x > r)
+        r = x;
+    }
+    if (l < r)
+      GP_SetSpanH(GP_FixCeil(l), GP_FixCeil(r) - 1, y, color, Buffer, w, h);
+  }
+}
+
+/* Fills a disc with fixed point center and radius. */
+static void GP_FillDiscFix(int32_t cx,
+                           int32_t cy,
+                           int32_t r,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  int32_t y1 = GP_FixCeil(cy - r);
+  int32_t y2 = (cy + r) >> GP_FIX_SHIFT;
+  if (y1 < 0)
+    y1 = 0;
+  if (y2 >= (int32_t)h)
+    y2 = (int32_t)h - 1;
+
+  for (int32_t y = y1; y <= y2; y++) {
+    int64_t dy = ((int64_t)y << GP_FIX_SHIFT) - cy;
+    int64_t d2 = (int64_t)r * r - dy * dy;
+    if (d2 < 0)
+      continue;
+    int32_t hw = (int32_t)GP_Isqrt((uint64_t)d2);
+    GP_SetSpanH(GP_FixCeil(cx - hw), (cx + hw) >> GP_FIX_SHIFT, y, color,
+                Buffer, w, h);
+  }
+}
+
 void GP_FILL(uint16_t x1,
              uint16_t y1,
              uint16_t x2,
@@ -198,490 +530,4957 @@ void GP_SetBresenhamLine(uint16_t x0,
   }
 }
 
-void GP_SetBresenhamCircle(uint16_t x0,
-                           uint16_t y0,
-                           uint16_t r,
-                           uint16_t color,
-                           uint16_t *Buffer,
-                           uint32_t w,
-                           uint32_t h)
+void GP_SetRunSliceLine(uint16_t x0,
+                        uint16_t y0,
+                        uint16_t x1,
+                        uint16_t y1,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h)
 {
-  int16_t x = 0;
-  int16_t y = r;
-  int16_t delta = 1 - 2 * r;
-  int16_t error = 0;
-  while (y >= 0)
-  {
-    pGP_SetPixel(x0 + x, y0 + y, color, Buffer, w, h);
-    pGP_SetPixel(x0 + x, y0 - y, color, Buffer, w, h);
-
-    pGP_SetPixel(x0 - x, y0 + y, color, Buffer, w, h);
-    pGP_SetPixel(x0 - x, y0 - y, color, Buffer, w, h);
-    error = 2 * (delta + y) - 1;
-    if (delta < 0 && error <= 0) {
-      ++x;
-      delta += 2 * x + 1;
-      continue;
+  int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int32_t dy = abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int32_t err = (dx > dy ? dx : -dy) / 2;
+  int32_t x = x0, y = y0, run;
+
+  /* Same error term as GP_SetBresenhamLine, but the length of every run
+     is found by one division and the run is drawn as a span. */
+  if (dx > dy) {
+    for (int32_t left = dx + 1; left > 0; left -= run) {
+      run = (dy == 0) ? left : (err >= dy ? err / dy : 0) + 1;
+      if (run > left)
+        run = left;
+      if (sx > 0)
+        GP_SetSpanH(x, x + run - 1, y, color, Buffer, w, h);
+      else
+        GP_SetSpanH(x - run + 1, x, y, color, Buffer, w, h);
+      x += sx * run;
+      y += sy;
+      err += dx - run * dy;
     }
-    error = 2 * (delta - x) - 1;
-    if (delta > 0 && error > 0) {
-      --y;
-      delta += 1 - 2 * y;
-      continue;
+  } else {
+    for (int32_t left = dy + 1; left > 0; left -= run) {
+      run = (dx == 0) ? left : (-err >= dx ? -err / dx : 0) + 1;
+      if (run > left)
+        run = left;
+      if (sy > 0)
+        GP_SetSpanV(x, y, y + run - 1, color, Buffer, w, h);
+      else
+        GP_SetSpanV(x, y - run + 1, y, color, Buffer, w, h);
+      y += sy * run;
+      x += sx;
+      err += run * dx - dy;
     }
-    ++x;
-    delta += 2 * (x - y);
-    --y;
   }
 }
 
-void GP_RoundedRect(uint16_t x0,
-                    uint16_t y0,
-                    int16_t width,
-                    int16_t heigth,
-                    uint16_t r,
-                    uint16_t color,
-                    uint16_t *Buffer,
-                    uint32_t w,
-                    uint32_t h)
+/**
+ *	Polyline stroker. Points are fed one by one, each segment body, join
+ *	and cap is a convex polygon filled by spans.
+ */
+typedef struct gp_stroker
 {
-  int16_t x = 0;
-  int16_t y = r;
-  int16_t delta = 1 - 2 * r;
-  int16_t error = 0;
+  int32_t px, py;       /**< Previous point. */
+  int32_t nx, ny;       /**< Normal of the previous segment, length hw. */
+  int32_t hw;           /**< Half of the stroke width. */
+  uint32_t count;       /**< Number of accepted points. */
+  uint8_t join;         /**< GP_JOIN_xxx. */
+  uint8_t cap;          /**< GP_CAP_xxx. */
+  uint16_t color;
+  uint16_t *Buffer;
+  uint32_t w;
+  uint32_t h;
+} GP_STROKER;
 
-  GP_SetLineH((x0 - width / 2) + r, (y0 - heigth / 2), width - r * 2, color,
-              Buffer, w, h);
-  GP_SetLineH((x0 - width / 2) + r, (y0 + heigth / 2), width - r * 2, color,
-              Buffer, w, h);
-  GP_SetLineV(x0 - width / 2 - 1, y0 - heigth / 2 + r, heigth - r * 2, color,
-              Buffer, w, h);
-  GP_SetLineV(x0 + width / 2 + 1, y0 - heigth / 2 + r, heigth - r * 2, color,
-              Buffer, w, h);
+static void GP_StrokerInit(GP_STROKER *st,
+                           int32_t hw,
+                           uint8_t join,
+                           uint8_t cap,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  st->count = 0;
+  st->hw = hw;
+  st->join = join;
+  st->cap = cap;
+  st->color = color;
+  st->Buffer = Buffer;
+  st->w = w;
+  st->h = h;
+}
 
-  while (y >= 0) {
-    pGP_SetPixel(x0 + x + (width / 2 - r), y0 + y + (heigth / 2 - r), color,
-                 Buffer, w, h);
-    pGP_SetPixel(x0 + x + (width / 2 - r), y0 - y - (heigth / 2 - r), color,
-                 Buffer, w, h);
-
-    pGP_SetPixel(x0 - x - (width / 2 - r), y0 + y + (heigth / 2 - r), color,
-                 Buffer, w, h);
-    pGP_SetPixel(x0 - x - (width / 2 - r), y0 - y - (heigth / 2 - r), color,
-                 Buffer, w, h);
-    error = 2 * (delta + y) - 1;
-    if (delta < 0 && error <= 0) {
-      ++x;
-      delta += 2 * x + 1;
-      continue;
-    }
-    error = 2 * (delta - x) - 1;
-    if (delta > 0 && error > 0) {
-      --y;
-      delta += 1 - 2 * y;
-      continue;
-    }
-    ++x;
-    delta += 2 * (x - y);
-    --y;
+static void GP_StrokeCap(GP_STROKER *st,
+                         int32_t x,
+                         int32_t y,
+                         int32_t ux,
+                         int32_t uy)
+{
+  int32_t px[4], py[4];
+
+  switch (st->cap) {
+  case GP_CAP_SQUARE:
+    px[0] = x + st->nx;      py[0] = y + st->ny;
+    px[1] = x + st->nx + ux; py[1] = y + st->ny + uy;
+    px[2] = x - st->nx + ux; py[2] = y - st->ny + uy;
+    px[3] = x - st->nx;      py[3] = y - st->ny;
+    GP_FillConvexFix(px, py, 4, st->color, st->Buffer, st->w, st->h);
+    break;
+  case GP_CAP_ROUND:
+    GP_FillDiscFix(x, y, st->hw, st->color, st->Buffer, st->w, st->h);
+    break;
+  default:
+    break;
   }
 }
 
-void GP_DrawFilledCircle(int16_t x0,
-                         int16_t y0,
-                         int16_t r,
-                         uint16_t color,
-                         uint16_t *Buffer,
-                         uint32_t w,
-                         uint32_t h)
+static void GP_StrokeJoin(GP_STROKER *st, int32_t nx, int32_t ny)
 {
-  int16_t x = r;
-  int16_t y = 0;
-  int16_t xChange = 1 - (r << 1);
-  int16_t yChange = 0;
-  int16_t rError = 0;
+  int32_t x = st->px, y = st->py;
+  int64_t turn = (int64_t)ny * st->nx - (int64_t)nx * st->ny;
+  int64_t hw2 = (int64_t)st->hw * st->hw;
+  int32_t ax = st->nx, ay = st->ny, bx = nx, by = ny;
+  int32_t px[4], py[4];
 
-  while (x >= y) {
-    for (int i = x0 - x; i <= x0 + x; i++) {
-      pGP_SetPixel(i, y0 + y, color, Buffer, w, h);
-      pGP_SetPixel(i, y0 - y, color, Buffer, w, h);
-    }
-    for (int i = x0 - y; i <= x0 + y; i++) {
-      pGP_SetPixel(i, y0 + x, color, Buffer, w, h);
-      pGP_SetPixel(i, y0 - x, color, Buffer, w, h);
-    }
-    y++;
-    rError += yChange;
-    yChange += 2;
-    if (((rError << 1) + xChange) > 0) {
-      x--;
-      rError += xChange;
-      xChange += 2;
-    }
+  if (st->join == GP_JOIN_ROUND) {
+    GP_FillDiscFix(x, y, st->hw, st->color, st->Buffer, st->w, st->h);
+    return;
+  }
+  if (turn == 0)
+    return;
+  if (turn > 0) {
+    ax = -ax; ay = -ay;
+    bx = -bx; by = -by;
+  }
+
+  px[0] = x;      py[0] = y;
+  px[1] = x + ax; py[1] = y + ay;
+  int64_t d = hw2 + (int64_t)ax * bx + (int64_t)ay * by;
+  if (st->join == GP_JOIN_MITER && d * 8 >= hw2) {
+    px[2] = x + (int32_t)((ax + bx) * hw2 / d);
+    py[2] = y + (int32_t)((ay + by) * hw2 / d);
+    px[3] = x + bx; py[3] = y + by;
+    GP_FillConvexFix(px, py, 4, st->color, st->Buffer, st->w, st->h);
+  } else {
+    px[2] = x + bx; py[2] = y + by;
+    GP_FillConvexFix(px, py, 3, st->color, st->Buffer, st->w, st->h);
   }
 }
 
-void GP_DrawRoundedFill(int16_t x0,
-                        int16_t y0,
-                        int16_t width,
-                        int16_t high,
-                        int16_t r,
-                        uint16_t color,
-                        uint16_t *Buffer,
-                        uint32_t w,
-                        uint32_t h)
+static void GP_StrokerAdd(GP_STROKER *st, int32_t x, int32_t y)
 {
-  int16_t x = r;
-  int16_t y = 0;
-  int16_t xChange = 1 - (r << 1);
-  int16_t yChange = 0;
-  int16_t rError = 0;
+  int32_t px[4], py[4];
 
-  GP_FILL(x0 - (width) / 2 + r, y0 - (high / 2), x0 + (width) / 2 - r,
-          y0 + (high / 2), color, Buffer, w, h);
-  GP_FILL(x0 - (width) / 2, y0 - (high / 2) + r, x0 + (width) / 2 + 1,
-          y0 + (high / 2) - r, color, Buffer, w, h);
+  if (st->count == 0) {
+    st->px = x;
+    st->py = y;
+    st->count = 1;
+    return;
+  }
 
-  while (x >= y)
-  {
-    for (int i = x0 - x - (width) / 2 + r; i <= x0 + x + (width) / 2 - r; i++)
-    {
-      pGP_SetPixel(i, y0 + y + (high / 2) - r, color, Buffer, w, h);
-      pGP_SetPixel(i, y0 - y - (high / 2) + r, color, Buffer, w, h);
-    }
-    for (int i = x0 - y - (width) / 2 + r; i <= x0 + y + (width) / 2 - r; i++)
-    {
-      pGP_SetPixel(i, y0 + x + (high / 2) - r, color, Buffer, w, h);
-      pGP_SetPixel(i, y0 - x - (high / 2) + r, color, Buffer, w, h);
-    }
-    y++;
-    rError += yChange;
-    yChange += 2;
-    if (((rError << 1) + xChange) > 0) {
-      x--;
-      rError += xChange;
-      xChange += 2;
-    }
+  int32_t dx = x - st->px, dy = y - st->py;
+  if (dx == 0 && dy == 0)
+    return;
+  int64_t len = GP_Isqrt((uint64_t)((int64_t)dx * dx + (int64_t)dy * dy));
+  int32_t nx = (int32_t)(-(int64_t)dy * st->hw / len);
+  int32_t ny = (int32_t)((int64_t)dx * st->hw / len);
+
+  if (st->count == 1) {
+    st->nx = nx;
+    st->ny = ny;
+    GP_StrokeCap(st, st->px, st->py, -ny, nx);
+  } else {
+    GP_StrokeJoin(st, nx, ny);
   }
+
+  px[0] = st->px + nx; py[0] = st->py + ny;
+  px[1] = x + nx;      py[1] = y + ny;
+  px[2] = x - nx;      py[2] = y - ny;
+  px[3] = st->px - nx; py[3] = st->py - ny;
+  GP_FillConvexFix(px, py, 4, st->color, st->Buffer, st->w, st->h);
+
+  st->px = x;
+  st->py = y;
+  st->nx = nx;
+  st->ny = ny;
+  st->count++;
 }
 
-void GP_SetArc(uint16_t x,
-               uint16_t y,
-               uint16_t a1,
-               uint16_t a2,
-               uint16_t r,
-               uint16_t color,
-               uint16_t *Buffer,
-               uint32_t w,
-               uint32_t h)
+static void GP_StrokerEnd(GP_STROKER *st)
 {
-  printf("This function is not implemented yet\n");
-  return;
+  if (st->count == 1) {
+    if (st->cap == GP_CAP_ROUND)
+      GP_FillDiscFix(st->px, st->py, st->hw, st->color, st->Buffer, st->w,
+                     st->h);
+  } else if (st->count > 1) {
+    GP_StrokeCap(st, st->px, st->py, st->ny, -st->nx);
+  }
+  st->count = 0;
 }
 
-void GP_PutTriangle(uint16_t x,
-                    uint16_t y,
-                    uint16_t width,
-                    uint16_t heigth,
-                    uint8_t side,
+void GP_SetThickLine(uint16_t x1,
+                     uint16_t y1,
+                     uint16_t x2,
+                     uint16_t y2,
+                     uint16_t thickness,
+                     uint8_t cap,
+                     uint16_t color,
+                     uint16_t *Buffer,
+                     uint32_t w,
+                     uint32_t h)
+{
+  GP_STROKER st;
+
+  if (thickness <= 1) {
+    GP_SetRunSliceLine(x1, y1, x2, y2, color, Buffer, w, h);
+    return;
+  }
+  GP_StrokerInit(&st, (int32_t)thickness << (GP_FIX_SHIFT - 1), GP_JOIN_BEVEL,
+                 cap, color, Buffer, w, h);
+  GP_StrokerAdd(&st, (int32_t)x1 << GP_FIX_SHIFT, (int32_t)y1 << GP_FIX_SHIFT);
+  GP_StrokerAdd(&st, (int32_t)x2 << GP_FIX_SHIFT, (int32_t)y2 << GP_FIX_SHIFT);
+  GP_StrokerEnd(&st);
+}
+
+void GP_SetPolyline(const uint16_t *x,
+                    const uint16_t *y,
+                    uint16_t n,
+                    uint16_t thickness,
+                    uint8_t join,
+                    uint8_t cap,
                     uint16_t color,
                     uint16_t *Buffer,
                     uint32_t w,
                     uint32_t h)
 {
-  uint16_t x1, y1, x2, y2, x3, y3;
-  switch (side) {
-  case NORTH:
-    x1 = x;
-    y1 = y - heigth / 2;
-    x2 = x - width / 2;
-    y2 = y + heigth / 2;
-    x3 = x + width / 2;
-    y3 = y + heigth / 2;
-    break;
-  case SOUTH:
-    x1 = x;
-    y1 = y + heigth / 2;
-    x2 = x - width / 2;
-    y2 = y - heigth / 2;
-    x3 = x + width / 2;
-    y3 = y - heigth / 2;
-    break;
-  case WEST:
-    x1 = x - width / 2;
-    y1 = y;
-    x2 = x + width / 2;
-    y2 = y - heigth / 2;
-    x3 = x + width / 2;
-    y3 = y + heigth / 2;
-    break;
-  case EAST:
-    x1 = x + width / 2;
-    y1 = y;
-    x2 = x - width / 2;
-    y2 = y + heigth / 2;
-    x3 = x - width / 2;
-    y3 = y - heigth / 2;
-    break;
-  default:
+  GP_STROKER st;
+
+  if (thickness <= 1) {
+    for (uint16_t i = 1; i < n; i++)
+      GP_SetRunSliceLine(x[i - 1], y[i - 1], x[i], y[i], color, Buffer, w, h);
     return;
   }
-  GP_SetBresenhamLine(x1, y1, x2, y2, color, Buffer, w, h);
-  GP_SetBresenhamLine(x2, y2, x3, y3, color, Buffer, w, h);
-  GP_SetBresenhamLine(x3, y3, x1, y1, color, Buffer, w, h);
+  GP_StrokerInit(&st, (int32_t)thickness << (GP_FIX_SHIFT - 1), join, cap,
+                 color, Buffer, w, h);
+  for (uint16_t i = 0; i < n; i++)
+    GP_StrokerAdd(&st, (int32_t)x[i] << GP_FIX_SHIFT,
+                  (int32_t)y[i] << GP_FIX_SHIFT);
+  GP_StrokerEnd(&st);
 }
 
-void GP_PutArrow(uint16_t x,
-                 uint16_t y,
-                 uint16_t width,
-                 uint16_t heigth,
-                 uint8_t side,
-                 uint16_t color,
-                 uint16_t *Buffer,
-                 uint32_t w,
-                 uint32_t h)
+/**
+ *	Curves are flattened by adaptive forward differencing: the step is
+ *	halved while the second difference is above the tolerance and doubled
+ *	back while it is well below, so the number of segments follows the size
+ *	and the bend of the curve. Differences are kept in 64 bit with
+ *	GP_AFD_SHIFT extra fraction bits, steps are powers of two down to
+ *	2^-GP_AFD_LEVELS.
+ */
+#define GP_AFD_SHIFT 30
+#define GP_AFD_LEVELS 10
+
+typedef void (*GP_POINT_SINK)(void *ctx, int32_t x, int32_t y);
+
+static inline int64_t GP_Abs64(int64_t v)
 {
+  return v < 0 ? -v : v;
+}
 
-  uint16_t l_w, l_h, x0, y0, x1_1, x1_2, y1_1, y1_2;
-  uint16_t x1, y1, x2, y2, x3, y3, x4, y4;
+/* Flattens a cubic given in power basis a*t^3 + b*t^2 + c*t + d. */
+static void GP_FlattenPoly(const int32_t *a,
+                           const int32_t *b,
+                           const int32_t *c,
+                           const int32_t *end,
+                           GP_POINT_SINK sink,
+                           void *ctx)
+{
+  int64_t p[2], d1[2], d2[2], d3[2];
+  int64_t lim = ((int64_t)GP_CURVE_TOLERANCE * 8) << GP_AFD_SHIFT;
+  int32_t t = 0, step = 1 << GP_AFD_LEVELS;
 
-  switch (side) {
-  case NORTH:
+  for (int i = 0; i < 2; i++) {
+    p[i] = 0;
+    d1[i] = (int64_t)(a[i] + b[i] + c[i]) * ((int64_t)1 << GP_AFD_SHIFT);
+    d2[i] = (int64_t)(6 * a[i] + 2 * b[i]) * ((int64_t)1 << GP_AFD_SHIFT);
+    d3[i] = (int64_t)(6 * a[i]) * ((int64_t)1 << GP_AFD_SHIFT);
+  }
+
+  while (t < (1 << GP_AFD_LEVELS)) {
+    while (step > 1 && (GP_Abs64(d2[0]) > lim || GP_Abs64(d2[1]) > lim)) {
+      for (int i = 0; i < 2; i++) {
+        d3[i] /= 8;
+        d2[i] = d2[i] / 4 - d3[i];
+        d1[i] = (d1[i] - d2[i]) / 2;
+      }
+      step >>= 1;
+    }
+    while (step < (1 << GP_AFD_LEVELS) && (t & (2 * step - 1)) == 0 &&
+           t + 2 * step <= (1 << GP_AFD_LEVELS) &&
+           GP_Abs64(d2[0] + d3[0]) * 8 <= lim &&
+           GP_Abs64(d2[1] + d3[1]) * 8 <= lim) {
+      for (int i = 0; i < 2; i++) {
+        d1[i] = 2 * d1[i] + d2[i];
+        d2[i] = 4 * d2[i] + 4 * d3[i];
+        d3[i] = 8 * d3[i];
+      }
+      step <<= 1;
+    }
+
+    t += step;
+    if (t >= (1 << GP_AFD_LEVELS)) {
+      sink(ctx, end[0], end[1]);
+      break;
+    }
+    for (int i = 0; i < 2; i++) {
+      p[i] += d1[i];
+      d1[i] += d2[i];
+      d2[i] += d3[i];
+    }
+    sink(ctx, end[2] + (int32_t)(p[0] >> GP_AFD_SHIFT),
+         end[3] + (int32_t)(p[1] >> GP_AFD_SHIFT));
+  }
+}
+
+/*
+ * Emits the points of a cubic Bezier curve (fixed point control points) after
+ * its start point.
+ */
+static void GP_FlattenCubic(const int32_t *px,
+                            const int32_t *py,
+                            GP_POINT_SINK sink,
+                            void *ctx)
+{
+  int32_t a[2], b[2], c[2], end[4];
+
+  a[0] = -px[0] + 3 * px[1] - 3 * px[2] + px[3];
+  a[1] = -py[0] + 3 * py[1] - 3 * py[2] + py[3];
+  b[0] = 3 * px[0] - 6 * px[1] + 3 * px[2];
+  b[1] = 3 * py[0] - 6 * py[1] + 3 * py[2];
+  c[0] = 3 * (px[1] - px[0]);
+  c[1] = 3 * (py[1] - py[0]);
+  end[0] = px[3];
+  end[1] = py[3];
+  end[2] = px[0];
+  end[3] = py[0];
+  GP_FlattenPoly(a, b, c, end, sink, ctx);
+}
+
+/* The same for a quadratic curve, its third difference is zero. */
+static void GP_FlattenQuad(const int32_t *px,
+                           const int32_t *py,
+                           GP_POINT_SINK sink,
+                           void *ctx)
+{
+  int32_t a[2] = {0, 0}, b[2], c[2], end[4];
+
+  b[0] = px[0] - 2 * px[1] + px[2];
+  b[1] = py[0] - 2 * py[1] + py[2];
+  c[0] = 2 * (px[1] - px[0]);
+  c[1] = 2 * (py[1] - py[0]);
+  end[0] = px[2];
+  end[1] = py[2];
+  end[2] = px[0];
+  end[3] = py[0];
+  GP_FlattenPoly(a, b, c, end, sink, ctx);
+}
+
+typedef struct gp_curve_line
+{
+  int32_t x, y;         /**< Last drawn point, in pixels. */
+  uint16_t color;
+  uint16_t *Buffer;
+  uint32_t w;
+  uint32_t h;
+} GP_CURVE_LINE;
+
+static void GP_CurveLineTo(void *ctx, int32_t x, int32_t y)
+{
+  GP_CURVE_LINE *l = ctx;
+
+  x = (x + GP_FIX_HALF) >> GP_FIX_SHIFT;
+  y = (y + GP_FIX_HALF) >> GP_FIX_SHIFT;
+  if (x == l->x && y == l->y)
+    return;
+  GP_SetRunSliceLine(l->x, l->y, x, y, l->color, l->Buffer, l->w, l->h);
+  l->x = x;
+  l->y = y;
+}
+
+static void GP_CurveStrokeTo(void *ctx, int32_t x, int32_t y)
+{
+  GP_StrokerAdd(ctx, x, y);
+}
+
+static void GP_DrawCurve(const uint16_t *x,
+                         const uint16_t *y,
+                         uint8_t n,
+                         uint16_t thickness,
+                         uint8_t cap,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  int32_t px[4], py[4];
+
+  for (uint8_t i = 0; i < n; i++) {
+    px[i] = (int32_t)x[i] << GP_FIX_SHIFT;
+    py[i] = (int32_t)y[i] << GP_FIX_SHIFT;
+  }
+
+  if (thickness <= 1) {
+    GP_CURVE_LINE l = {x[0], y[0], color, Buffer, w, h};
+    GP_SetRunSliceLine(x[0], y[0], x[0], y[0], color, Buffer, w, h);
+    if (n == 3)
+      GP_FlattenQuad(px, py, GP_CurveLineTo, &l);
+    else
+      GP_FlattenCubic(px, py, GP_CurveLineTo, &l);
+    return;
+  }
+
+  GP_STROKER st;
+  GP_StrokerInit(&st, (int32_t)thickness << (GP_FIX_SHIFT - 1), GP_JOIN_MITER,
+                 cap, color, Buffer, w, h);
+  GP_StrokerAdd(&st, px[0], py[0]);
+  if (n == 3)
+    GP_FlattenQuad(px, py, GP_CurveStrokeTo, &st);
+  else
+    GP_FlattenCubic(px, py, GP_CurveStrokeTo, &st);
+  GP_StrokerEnd(&st);
+}
+
+void GP_SetBezierQuad(uint16_t x0,
+                      uint16_t y0,
+                      uint16_t x1,
+                      uint16_t y1,
+                      uint16_t x2,
+                      uint16_t y2,
+                      uint16_t color,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h)
+{
+  uint16_t x[3] = {x0, x1, x2}, y[3] = {y0, y1, y2};
+
+  GP_DrawCurve(x, y, 3, 1, GP_CAP_BUTT, color, Buffer, w, h);
+}
+
+void GP_SetBezierCubic(uint16_t x0,
+                       uint16_t y0,
+                       uint16_t x1,
+                       uint16_t y1,
+                       uint16_t x2,
+                       uint16_t y2,
+                       uint16_t x3,
+                       uint16_t y3,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  uint16_t x[4] = {x0, x1, x2, x3}, y[4] = {y0, y1, y2, y3};
+
+  GP_DrawCurve(x, y, 4, 1, GP_CAP_BUTT, color, Buffer, w, h);
+}
+
+void GP_StrokeBezierQuad(uint16_t x0,
+                         uint16_t y0,
+                         uint16_t x1,
+                         uint16_t y1,
+                         uint16_t x2,
+                         uint16_t y2,
+                         uint16_t thickness,
+                         uint8_t cap,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  uint16_t x[3] = {x0, x1, x2}, y[3] = {y0, y1, y2};
+
+  GP_DrawCurve(x, y, 3, thickness, cap, color, Buffer, w, h);
+}
+
+void GP_StrokeBezierCubic(uint16_t x0,
+                          uint16_t y0,
+                          uint16_t x1,
+                          uint16_t y1,
+                          uint16_t x2,
+                          uint16_t y2,
+                          uint16_t x3,
+                          uint16_t y3,
+                          uint16_t thickness,
+                          uint8_t cap,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  uint16_t x[4] = {x0, x1, x2, x3}, y[4] = {y0, y1, y2, y3};
+
+  GP_DrawCurve(x, y, 4, thickness, cap, color, Buffer, w, h);
+}
+
+/**
+ *	Circle outlines are drawn from one octant of offsets (0 <= x <= y)
+ *	mirrored eight times. Octants of small radiuses are kept in a small
+ *	LRU cache, bigger ones are walked in chunks.
+ */
+typedef struct gp_circle_walk
+{
+  int32_t x, y;
+  int32_t delta;
+} GP_CIRCLE_WALK;
+
+typedef struct gp_circle_octant
+{
+  uint16_t r;           /**< Radius of the octant. */
+  uint16_t n;           /**< Number of offsets, 0 for a free entry. */
+  uint32_t used;        /**< Last use, for LRU replacement. */
+  uint16_t x[GP_CIRCLE_OCTANT_MAX];
+  uint16_t y[GP_CIRCLE_OCTANT_MAX];
+} GP_CIRCLE_OCTANT;
+
+static GP_CIRCLE_OCTANT GP_CircleCache[GP_CIRCLE_CACHE_SIZE];
+static uint32_t GP_CircleClock;
+
+/* Octant signs and swap of x and y: {swap, sx, sy}, clockwise from north. */
+static const int8_t GP_Octant[8][3] = {
+    {0, 1, -1}, {1, 1, -1}, {1, 1, 1},  {0, 1, 1},
+    {0, -1, 1}, {1, -1, 1}, {1, -1, -1}, {0, -1, -1}};
+
+static void GP_CircleWalkInit(GP_CIRCLE_WALK *cw, int32_t r)
+{
+  cw->x = 0;
+  cw->y = r;
+  cw->delta = 1 - 2 * r;
+}
+
+/* Continues the midpoint walk of the first octant, returns offsets count. */
+static uint16_t GP_CircleWalkNext(GP_CIRCLE_WALK *cw,
+                                  uint16_t *ox,
+                                  uint16_t *oy,
+                                  uint16_t max)
+{
+  uint16_t n = 0;
+  int32_t error;
+
+  while (n < max && cw->x <= cw->y) {
+    ox[n] = cw->x;
+    oy[n] = cw->y;
+    n++;
+    error = 2 * (cw->delta + cw->y) - 1;
+    if (cw->delta < 0 && error <= 0) {
+      ++cw->x;
+      cw->delta += 2 * cw->x + 1;
+      continue;
+    }
+    error = 2 * (cw->delta - cw->x) - 1;
+    if (cw->delta > 0 && error > 0) {
+      --cw->y;
+      cw->delta += 1 - 2 * cw->y;
+      continue;
+    }
+    ++cw->x;
+    cw->delta += 2 * (cw->x - cw->y);
+    --cw->y;
+  }
+  return n;
+}
+
+static const GP_CIRCLE_OCTANT *GP_CircleOctant(uint16_t r)
+{
+  GP_CIRCLE_OCTANT *e = &GP_CircleCache[0];
+  GP_CIRCLE_WALK cw;
+
+  if (r > GP_CIRCLE_CACHE_MAX_R)
+    return NULL;
+
+  GP_CircleClock++;
+  for (uint8_t i = 0; i < GP_CIRCLE_CACHE_SIZE; i++) {
+    GP_CIRCLE_OCTANT *c = &GP_CircleCache[i];
+    if (c->n != 0 && c->r == r) {
+      c->used = GP_CircleClock;
+      return c;
+    }
+    if (c->n == 0 || c->used < e->used)
+      e = c;
+  }
+
+  GP_CircleWalkInit(&cw, r);
+  e->r = r;
+  e->n = GP_CircleWalkNext(&cw, e->x, e->y, GP_CIRCLE_OCTANT_MAX);
+  e->used = GP_CircleClock;
+  return e;
+}
+
+/*
+ * Plots offsets ox/oy of the first octant mirrored to the octants in mask
+ * around (cx, cy). Every octant is clipped as a whole: it is skipped when out
+ * of the buffer, drawn without checks when inside and clipped per pixel only
+ * when it crosses the border.
+ */
+static void GP_PlotOctants(int32_t cx,
+                           int32_t cy,
+                           const uint16_t *ox,
+                           const uint16_t *oy,
+                           uint16_t n,
+                           uint8_t mask,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  int32_t px = GP_IsRotated() ? -1 : 1;
+  int32_t py = px * (int32_t)w;
+  /* Signed, the center may be past any side of the buffer. */
+  int64_t base = (int64_t)cx + (int64_t)w * cy;
+
+  if (GP_IsRotated())
+    base = ((int64_t)w - 1 - cx) + (int64_t)w * ((int64_t)h - 1 - cy);
+
+  if (n == 0)
+    return;
+
+  for (uint8_t k = 0; k < 8; k++) {
+    const int8_t *o = GP_Octant[k];
+    int32_t x1, x2, y1, y2, a, b;
+
+    if (!(mask & (1 << k)))
+      continue;
+
+    /* Offsets go with x up and y down. */
+    if (o[0]) {
+      x1 = cx + o[1] * oy[n - 1];
+      x2 = cx + o[1] * oy[0];
+      y1 = cy + o[2] * ox[0];
+      y2 = cy + o[2] * ox[n - 1];
+      a = o[2] * py;
+      b = o[1] * px;
+    } else {
+      x1 = cx + o[1] * ox[0];
+      x2 = cx + o[1] * ox[n - 1];
+      y1 = cy + o[2] * oy[n - 1];
+      y2 = cy + o[2] * oy[0];
+      a = o[1] * px;
+      b = o[2] * py;
+    }
+    if (x1 > x2) {
+      int32_t t = x1; x1 = x2; x2 = t;
+    }
+    if (y1 > y2) {
+      int32_t t = y1; y1 = y2; y2 = t;
+    }
+    if (x2 < 0 || y2 < 0 || x1 >= (int32_t)w || y1 >= (int32_t)h)
+      continue;
+
+    if (x1 >= 0 && y1 >= 0 && x2 < (int32_t)w && y2 < (int32_t)h) {
+      for (uint16_t i = 0; i < n; i++)
+        Buffer[base + ox[i] * a + oy[i] * b] = color;
+      continue;
+    }
+
+    for (uint16_t i = 0; i < n; i++) {
+      int32_t x = cx + o[1] * (o[0] ? oy[i] : ox[i]);
+      int32_t y = cy + o[2] * (o[0] ? ox[i] : oy[i]);
+      if (x >= 0 && y >= 0 && x < (int32_t)w && y < (int32_t)h)
+        Buffer[base + ox[i] * a + oy[i] * b] = color;
+    }
+  }
+}
+
+/* Draws the octants in mask of the circle outline of radius r. */
+static void GP_DrawOctants(int32_t cx,
+                           int32_t cy,
+                           uint16_t r,
+                           uint8_t mask,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  const GP_CIRCLE_OCTANT *c = GP_CircleOctant(r);
+  uint16_t ox[GP_CIRCLE_OCTANT_MAX], oy[GP_CIRCLE_OCTANT_MAX], n;
+  GP_CIRCLE_WALK cw;
+
+  if (c != NULL) {
+    GP_PlotOctants(cx, cy, c->x, c->y, c->n, mask, color, Buffer, w, h);
+    return;
+  }
+
+  GP_CircleWalkInit(&cw, r);
+  while ((n = GP_CircleWalkNext(&cw, ox, oy, GP_CIRCLE_OCTANT_MAX)) != 0)
+    GP_PlotOctants(cx, cy, ox, oy, n, mask, color, Buffer, w, h);
+}
+
+void GP_SetBresenhamCircle(uint16_t x0,
+                           uint16_t y0,
+                           uint16_t r,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  GP_DrawOctants(x0, y0, r, 0xFF, color, Buffer, w, h);
+}
+
+void GP_RoundedRect(uint16_t x0,
+                    uint16_t y0,
+                    int16_t width,
+                    int16_t heigth,
+                    uint16_t r,
+                    uint16_t color,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h)
+{
+  int32_t a = width / 2 - r;
+  int32_t b = heigth / 2 - r;
+
+  GP_SetSpanH(x0 - a, x0 - a + width - 2 * r - 1, y0 - heigth / 2, color,
+              Buffer, w, h);
+  GP_SetSpanH(x0 - a, x0 - a + width - 2 * r - 1, y0 + heigth / 2, color,
+              Buffer, w, h);
+  GP_SetSpanV(x0 - width / 2, y0 - b, y0 - b + heigth - 2 * r - 1, color,
+              Buffer, w, h);
+  GP_SetSpanV(x0 + width / 2, y0 - b, y0 - b + heigth - 2 * r - 1, color,
+              Buffer, w, h);
+
+  GP_DrawOctants(x0 + a, y0 - b, r, GP_OCTANTS_NE, color, Buffer, w, h);
+  GP_DrawOctants(x0 + a, y0 + b, r, GP_OCTANTS_SE, color, Buffer, w, h);
+  GP_DrawOctants(x0 - a, y0 + b, r, GP_OCTANTS_SW, color, Buffer, w, h);
+  GP_DrawOctants(x0 - a, y0 - b, r, GP_OCTANTS_NW, color, Buffer, w, h);
+}
+
+/* Emits the rows dy and -dy of a rounded shape with halves offset by b. */
+static inline void GP_RoundedRows(int32_t x0,
+                                  int32_t y0,
+                                  int32_t a,
+                                  int32_t b,
+                                  int32_t dy,
+                                  int32_t hw,
+                                  uint16_t color,
+                                  uint16_t *Buffer,
+                                  uint32_t w,
+                                  uint32_t h)
+{
+  GP_SetSpanH(x0 - a - hw, x0 + a + hw, y0 + b + dy, color, Buffer, w, h);
+  if (b + dy != 0)
+    GP_SetSpanH(x0 - a - hw, x0 + a + hw, y0 - b - dy, color, Buffer, w, h);
+}
+
+/*
+ * Fills a circle of radius r whose right and left halves are moved apart by
+ * a and the top and bottom halves by b. Every row is drawn once: the rows
+ * below the diagonal come from the walk over y, the rows above it are drawn
+ * when the walk leaves them. Pixels are the same as the midpoint walk of
+ * GP_DrawFilledCircle always drew.
+ */
+static void GP_FillRoundedRows(int32_t x0,
+                               int32_t y0,
+                               int32_t a,
+                               int32_t b,
+                               int32_t r,
+                               uint16_t color,
+                               uint16_t *Buffer,
+                               uint32_t w,
+                               uint32_t h)
+{
+  int32_t x = r;
+  int32_t y = 0;
+  int32_t xChange = 1 - (r << 1);
+  int32_t yChange = 0;
+  int32_t rError = 0;
+
+  if (r < 0)
+    return;
+
+  for (int32_t i = y0 - b + 1; i < y0 + b; i++)
+    GP_SetSpanH(x0 - a - r, x0 + a + r, i, color, Buffer, w, h);
+
+  while (x >= y) {
+    GP_RoundedRows(x0, y0, a, b, y, x, color, Buffer, w, h);
+    rError += yChange;
+    yChange += 2;
+    if ((rError * 2 + xChange) > 0) {
+      if (x > y)
+        GP_RoundedRows(x0, y0, a, b, x, y, color, Buffer, w, h);
+      x--;
+      rError += xChange;
+      xChange += 2;
+    }
+    y++;
+  }
+}
+
+void GP_DrawFilledCircle(int16_t x0,
+                         int16_t y0,
+                         int16_t r,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  GP_FillRoundedRows(x0, y0, 0, 0, r, color, Buffer, w, h);
+}
+
+void GP_DrawRoundedFill(int16_t x0,
+                        int16_t y0,
+                        int16_t width,
+                        int16_t high,
+                        int16_t r,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h)
+{
+  if (width < 0 || high < 0)
+    return;
+  if (r > width / 2)
+    r = width / 2;
+  if (r > high / 2)
+    r = high / 2;
+
+  GP_FillRoundedRows(x0, y0, width / 2 - r, high / 2 - r, r, color, Buffer, w,
+                     h);
+}
+
+/*
+ * Draws the run xs..xe of quadrant row dy of an ellipse mirrored to all
+ * quadrants. Runs from the axis and rows of a filled ellipse are drawn as
+ * the whole row -xe..xe.
+ */
+static void GP_EllipseRun(int32_t x0,
+                          int32_t y0,
+                          int32_t xs,
+                          int32_t xe,
+                          int32_t dy,
+                          bool fill,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  if (fill || xs == 0)
+    xs = -xe;
+  GP_SetSpanH(x0 + xs, x0 + xe, y0 + dy, color, Buffer, w, h);
+  if (dy != 0)
+    GP_SetSpanH(x0 + xs, x0 + xe, y0 - dy, color, Buffer, w, h);
+  if (xs <= 0)
+    return;
+  GP_SetSpanH(x0 - xe, x0 - xs, y0 + dy, color, Buffer, w, h);
+  if (dy != 0)
+    GP_SetSpanH(x0 - xe, x0 - xs, y0 - dy, color, Buffer, w, h);
+}
+
+/*
+ * Midpoint ellipse. The quadrant is walked from the top, stepping x while
+ * the slope is below 1 and y after that; decisions are kept multiplied by 4
+ * to stay integer. Pixels of one row are drawn as one run.
+ */
+static void GP_Ellipse(int32_t x0,
+                       int32_t y0,
+                       int32_t rx,
+                       int32_t ry,
+                       bool fill,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  int64_t a2 = (int64_t)rx * rx, b2 = (int64_t)ry * ry;
+  int64_t dx = 0, dy = 2 * a2 * ry, d = 4 * b2 - 4 * a2 * ry + a2;
+  int32_t x = 0, y = ry, xs = 0;
+
+  if (rx < 0 || ry < 0)
+    return;
+
+  while (dx < dy) {
+    if (d >= 0) {
+      GP_EllipseRun(x0, y0, xs, x, y, fill, color, Buffer, w, h);
+      y--;
+      xs = x + 1;
+      dy -= 2 * a2;
+      d -= 4 * dy;
+    }
+    x++;
+    dx += 2 * b2;
+    d += 4 * (dx + b2);
+  }
+
+  d = b2 * (2 * x + 1) * (2 * x + 1) +
+      4 * a2 * ((int64_t)(y - 1) * (y - 1) - b2);
+  while (y > 0) {
+    bool diagonal = d <= 0;
+
+    GP_EllipseRun(x0, y0, xs, x, y, fill, color, Buffer, w, h);
+    y--;
+    dy -= 2 * a2;
+    d += 4 * (a2 - dy);
+    if (diagonal) {
+      x++;
+      dx += 2 * b2;
+      d += 4 * dx;
+    }
+    xs = x;
+  }
+
+  /* Thin ellipses end above the tip, the last row reaches it. */
+  GP_EllipseRun(x0, y0, xs, rx, 0, fill, color, Buffer, w, h);
+}
+
+void GP_SetEllipse(int16_t x0,
+                   int16_t y0,
+                   int16_t rx,
+                   int16_t ry,
+                   uint16_t color,
+                   uint16_t *Buffer,
+                   uint32_t w,
+                   uint32_t h)
+{
+  GP_Ellipse(x0, y0, rx, ry, false, color, Buffer, w, h);
+}
+
+void GP_DrawFilledEllipse(int16_t x0,
+                          int16_t y0,
+                          int16_t rx,
+                          int16_t ry,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  GP_Ellipse(x0, y0, rx, ry, true, color, Buffer, w, h);
+}
+
+/* Coverage of the pixel at (dx, dy) of a ring of radiuses ri..ro. */
+static uint8_t GP_RingCoverage(int32_t dx, int32_t dy, int32_t ro, int32_t ri)
+{
+  int32_t d = (int32_t)GP_Isqrt(((uint64_t)dx * dx + (uint64_t)dy * dy) << 16);
+  int32_t c = ((ro + 1) << 8) - d;
+
+  if (ri > 0 && d - ((ri - 1) << 8) < c)
+    c = d - ((ri - 1) << 8);
+  return c <= 0 ? 0 : c >= 255 ? 255 : (uint8_t)c;
+}
+
+/*
+ * Offsets |dx| of row dy of a ring of radiuses ri..ro: covered ones are
+ * e[0]..e[1], solid ones e[2]..e[3] (none when e[2] > e[3]). Returns false
+ * when the row is not covered at all.
+ */
+static bool GP_RingBounds(int32_t dy, int32_t ro, int32_t ri, int32_t *e)
+{
+  int64_t o2 = (int64_t)(ro + 1) * (ro + 1) - (int64_t)dy * dy;
+  int64_t i2 = (int64_t)(ri - 1) * (ri - 1) - (int64_t)dy * dy;
+  int32_t e1 = 0, e2, s1 = 0, s2 = -1;
+
+  if (o2 <= 0)
+    return false;
+  e2 = (int32_t)GP_Isqrt((uint64_t)o2);
+  if ((int64_t)e2 * e2 == o2)
+    e2--;
+  if ((int64_t)ro * ro >= (int64_t)dy * dy)
+    s2 = (int32_t)GP_Isqrt((uint64_t)((int64_t)ro * ro - (int64_t)dy * dy));
+  if (ri > 0) {
+    int64_t s = (int64_t)ri * ri - (int64_t)dy * dy;
+    if (i2 >= 0)
+      e1 = (int32_t)GP_Isqrt((uint64_t)i2) + 1;
+    if (s > 0) {
+      s1 = (int32_t)GP_Isqrt((uint64_t)s);
+      if ((int64_t)s1 * s1 < s)
+        s1++;
+    }
+  }
+  if (s1 > s2) {
+    s1 = e2 + 1;
+    s2 = e2;
+  }
+  e[0] = e1;
+  e[1] = e2;
+  e[2] = s1;
+  e[3] = s2;
+  return true;
+}
+
+/*
+ * Draws row y, the row dy of an anti-aliased ring of radiuses ri..ro whose
+ * halves are moved apart by a. Pixels with full coverage are drawn by spans,
+ * only the edge pixels are blended.
+ */
+static void GP_AARingRow(int32_t x0,
+                         int32_t y,
+                         int32_t a,
+                         int32_t dy,
+                         int32_t ro,
+                         int32_t ri,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  int32_t e[4], e1, e2, s1, s2;
+  uint8_t c;
+
+  if (y < 0 || y >= (int32_t)h || !GP_RingBounds(dy, ro, ri, e))
+    return;
+  e1 = e[0];
+  e2 = e[1];
+  s1 = e[2];
+  s2 = e[3];
+
+  if (e1 == 0) {
+    c = GP_RingCoverage(0, dy, ro, ri);
+    if (c == 255) {
+      GP_SetSpanH(x0 - a, x0 + a, y, color, Buffer, w, h);
+    } else {
+      for (int32_t x = x0 - a; x <= x0 + a; x++)
+        GP_BlendPixel(x, y, color, c, Buffer, w, h);
+    }
+    e1 = 1;
+  }
+  if (s1 < e1)
+    s1 = e1;
+  if (s1 <= s2) {
+    GP_SetSpanH(x0 + a + s1, x0 + a + s2, y, color, Buffer, w, h);
+    GP_SetSpanH(x0 - a - s2, x0 - a - s1, y, color, Buffer, w, h);
+  }
+  for (int32_t k = e1; k <= e2; k++) {
+    if (k == s1 && s1 <= s2) {
+      k = s2;
+      continue;
+    }
+    c = GP_RingCoverage(k, dy, ro, ri);
+    GP_BlendPixel(x0 + a + k, y, color, c, Buffer, w, h);
+    GP_BlendPixel(x0 - a - k, y, color, c, Buffer, w, h);
+  }
+}
+
+static void GP_AARoundedRows(int32_t x0,
+                             int32_t y0,
+                             int32_t a,
+                             int32_t b,
+                             int32_t ro,
+                             int32_t ri,
+                             uint16_t color,
+                             uint16_t *Buffer,
+                             uint32_t w,
+                             uint32_t h)
+{
+  if (ro < 0)
+    return;
+  for (int32_t i = y0 - b + 1; i < y0 + b; i++)
+    GP_AARingRow(x0, i, a, 0, ro, ri, color, Buffer, w, h);
+  for (int32_t dy = 0; dy <= ro; dy++) {
+    GP_AARingRow(x0, y0 + b + dy, a, dy, ro, ri, color, Buffer, w, h);
+    if (b + dy != 0)
+      GP_AARingRow(x0, y0 - b - dy, a, dy, ro, ri, color, Buffer, w, h);
+  }
+}
+
+void GP_DrawFilledCircleAA(int16_t x0,
+                           int16_t y0,
+                           int16_t r,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  GP_AARoundedRows(x0, y0, 0, 0, r, 0, color, Buffer, w, h);
+}
+
+void GP_DrawRingAA(int16_t x0,
+                   int16_t y0,
+                   int16_t r_outer,
+                   int16_t r_inner,
+                   uint16_t color,
+                   uint16_t *Buffer,
+                   uint32_t w,
+                   uint32_t h)
+{
+  if (r_inner > r_outer)
+    return;
+  GP_AARoundedRows(x0, y0, 0, 0, r_outer, r_inner, color, Buffer, w, h);
+}
+
+void GP_DrawRoundedFillAA(int16_t x0,
+                          int16_t y0,
+                          int16_t width,
+                          int16_t high,
+                          int16_t r,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  if (width < 0 || high < 0)
+    return;
+  if (r > width / 2)
+    r = width / 2;
+  if (r > high / 2)
+    r = high / 2;
+
+  GP_AARoundedRows(x0, y0, width / 2 - r, high / 2 - r, r, 0, color, Buffer,
+                   w, h);
+}
+
+void GP_RoundedRectAA(int16_t x0,
+                      int16_t y0,
+                      int16_t width,
+                      int16_t heigth,
+                      int16_t r,
+                      uint16_t color,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h)
+{
+  if (width < 0 || heigth < 0)
+    return;
+  if (r > width / 2)
+    r = width / 2;
+  if (r > heigth / 2)
+    r = heigth / 2;
+  if (r < 1)
+    r = 1;
+
+  GP_AARoundedRows(x0, y0, width / 2 - r, heigth / 2 - r, r, r, color, Buffer,
+                   w, h);
+}
+
+/*
+ * Band sort of batches. Items of rows GP_BandY1..GP_BandY2 (inclusive) are
+ * put in order of their first band by a stable counting sort, then the bands
+ * are swept with a list of the items still over them, in the order of the
+ * batch.
+ */
+
+static int32_t GP_BandY1[GP_BATCH_MAX], GP_BandY2[GP_BATCH_MAX];
+static uint32_t GP_BandItem[GP_BATCH_MAX]; /* Index in the caller's arrays. */
+static uint16_t GP_BandFirst[GP_BATCH_BANDS + 1]; /* End of each band. */
+static uint16_t GP_BandSorted[GP_BATCH_MAX];
+static uint16_t GP_BandOver[GP_BATCH_MAX];
+static uint16_t GP_BandActive[GP_BATCH_MAX];
+static uint8_t GP_BandOf[GP_BATCH_MAX]; /* First band, GP_BATCH_BANDS: none. */
+
+/* Sorts items 0..m - 1 over rows win..win_end by their band of rows rows. */
+static void GP_BandSort(uint16_t m, int32_t win, int32_t win_end, int32_t rows)
+{
+  memset(GP_BandFirst, 0, sizeof(GP_BandFirst));
+  for (uint16_t k = 0; k < m; k++) {
+    GP_BandOf[k] = GP_BATCH_BANDS;
+    if (GP_BandY1[k] <= win_end && GP_BandY2[k] >= win) {
+      GP_BandOf[k] =
+          (uint8_t)(((GP_BandY1[k] > win ? GP_BandY1[k] : win) - win) / rows);
+      GP_BandFirst[GP_BandOf[k] + 1]++;
+    }
+  }
+  for (uint16_t b = 1; b <= GP_BATCH_BANDS; b++)
+    GP_BandFirst[b] += GP_BandFirst[b - 1];
+  for (uint16_t k = 0; k < m; k++)
+    if (GP_BandOf[k] < GP_BATCH_BANDS)
+      GP_BandSorted[GP_BandFirst[GP_BandOf[k]]++] = k;
+}
+
+/*
+ * Puts the items over band b (ending at row band_end) in GP_BandOver in
+ * their order and returns their number. *na is the length of the list kept
+ * between the bands of a window, 0 at its first band.
+ */
+static uint16_t GP_BandNext(uint16_t b, int32_t band_end, uint16_t *na)
+{
+  uint16_t i = b ? GP_BandFirst[b - 1] : 0, end = GP_BandFirst[b];
+  uint16_t active = *na, j = 0, n = 0, kept = 0;
+
+  while (j < active || i < end)
+    GP_BandOver[n++] =
+        i == end || (j < active && GP_BandActive[j] < GP_BandSorted[i])
+            ? GP_BandActive[j++]
+            : GP_BandSorted[i++];
+  for (uint16_t k = 0; k < n; k++)
+    if (GP_BandY2[GP_BandOver[k]] > band_end)
+      GP_BandActive[kept++] = GP_BandOver[k];
+  *na = kept;
+  return n;
+}
+
+void GP_FillRects(const uint16_t *x,
+                  const uint16_t *y,
+                  const uint16_t *width,
+                  const uint16_t *height,
+                  const uint16_t *colors,
+                  uint32_t n,
+                  uint16_t *Buffer,
+                  uint32_t w,
+                  uint32_t h)
+{
+  int32_t stride = GP_IsRotated() ? -(int32_t)w : (int32_t)w;
+  const int32_t rows = GP_BATCH_BAND * GP_BATCH_BANDS;
+
+  /* Bands of rows are swept top to bottom, inside a band the rectangles
+     keep their order, so overlapping rectangles look as drawn one by one. */
+  for (uint32_t i0 = 0; i0 < n; i0 += GP_BATCH_MAX) {
+    uint32_t i1 = n - i0 < GP_BATCH_MAX ? n : i0 + GP_BATCH_MAX;
+    int32_t top = (int32_t)h, bottom = -1;
+    uint16_t m = 0;
+
+    for (uint32_t i = i0; i < i1; i++) {
+      int32_t y2 = (int32_t)y[i] + height[i] - 1;
+      if (width[i] == 0 || height[i] == 0 || x[i] >= w || y[i] >= h)
+        continue;
+      GP_BandY1[m] = y[i];
+      GP_BandY2[m] = y2 > (int32_t)h - 1 ? (int32_t)h - 1 : y2;
+      if (GP_BandY1[m] < top)
+        top = GP_BandY1[m];
+      if (GP_BandY2[m] > bottom)
+        bottom = GP_BandY2[m];
+      GP_BandItem[m++] = i;
+    }
+
+    for (int32_t win = top; win <= bottom; win += rows) {
+      int32_t win_end = win + rows - 1 < bottom ? win + rows - 1 : bottom;
+      uint16_t na = 0;
+
+      GP_BandSort(m, win, win_end, GP_BATCH_BAND);
+      for (int32_t band = win, b = 0; band <= win_end;
+           band += GP_BATCH_BAND, b++) {
+        int32_t band_end = band + GP_BATCH_BAND - 1 < win_end
+                               ? band + GP_BATCH_BAND - 1
+                               : win_end;
+        uint16_t over = GP_BandNext((uint16_t)b, band_end, &na);
+
+        for (uint16_t k = 0; k < over; k++) {
+          uint16_t j = GP_BandOver[k];
+          uint32_t i = GP_BandItem[j];
+          int32_t y1 = GP_BandY1[j] > band ? GP_BandY1[j] : band;
+          int32_t y2 = GP_BandY2[j] < band_end ? GP_BandY2[j] : band_end;
+          int32_t x1 = x[i];
+          int32_t x2 = (int32_t)x[i] + width[i] - 1;
+          uint16_t *p;
+
+          if (x2 >= (int32_t)w)
+            x2 = (int32_t)w - 1;
+          p = GP_PixelPtr(GP_IsRotated() ? x2 : x1, y1, Buffer, w, h);
+          for (; y1 <= y2; y1++, p += stride)
+            GP_FillSpan(p, x2 - x1 + 1, colors[i]);
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Draws rows r1..r2 of the Bresenham line x0, y0 - x1, y1 of
+ * GP_SetBresenhamLine. Its error term stays in 0..dx - 1 when dx > dy (and
+ * in 0..dy - 1, negated, else), so step i of a flat line is at row
+ * ceil((i * dy - dx / 2) / dx) and row j of a steep one at column
+ * ceil((j * dx - dy / 2) / dy): any row is found without the steps before.
+ */
+static void GP_LineRows(int32_t x0,
+                        int32_t y0,
+                        int32_t x1,
+                        int32_t y1,
+                        int32_t r1,
+                        int32_t r2,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h)
+{
+  int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int32_t dy = abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int32_t j = (sy > 0 ? r1 - y0 : y0 - r2), n = r2 - r1 + 1;
+
+  if (dx > dy) {
+    /* Row j holds the steps ((j - 1) * dx + e) / dy + 1..(j * dx + e) / dy,
+       the quotient q and remainder rem of (j * dx + e) / dy are stepped. */
+    uint32_t e = (uint32_t)dx / 2;
+    int32_t i1 = 0, q = dx, rem = 0, qd = 0, rd = 0;
+
+    if (dy) {
+      /* Row j - 1 first, j * dx + e stays below 2^32 for 16 bit ends. */
+      uint32_t a = (uint32_t)(j ? j - 1 : 0) * (uint32_t)dx + e;
+      q = (int32_t)(a / (uint32_t)dy);
+      rem = (int32_t)(a % (uint32_t)dy);
+      qd = dx / dy;
+      rd = dx % dy;
+      if (j) {
+        i1 = q + 1;
+        q += qd;
+        rem += rd;
+        if (rem >= dy) {
+          rem -= dy;
+          q++;
+        }
+      }
+    }
+    for (; n > 0; n--, j++) {
+      int32_t i2 = q < dx ? q : dx;
+      if (sx > 0)
+        GP_SetSpanH(x0 + i1, x0 + i2, y0 + sy * j, color, Buffer, w, h);
+      else
+        GP_SetSpanH(x0 - i2, x0 - i1, y0 + sy * j, color, Buffer, w, h);
+      i1 = i2 + 1;
+      q += qd;
+      rem += rd;
+      if (rem >= dy && dy) {
+        rem -= dy;
+        q++;
+      }
+    }
+  } else {
+    /* Column k of row j and the error term there, then the usual steps. */
+    uint32_t a = (uint32_t)j * (uint32_t)dx, hd = (uint32_t)dy / 2;
+    int32_t k = a <= hd ? 0 : (int32_t)((a - hd + dy - 1) / (uint32_t)dy);
+    int32_t e = (int32_t)((uint32_t)k * (uint32_t)dy + hd - a);
+    int32_t x = x0 + sx * k;
+
+    if (x0 >= 0 && x1 >= 0 && x0 < (int32_t)w && x1 < (int32_t)w) {
+      int32_t px = GP_IsRotated() ? -sx : sx;
+      int32_t py = (GP_IsRotated() ? -sy : sy) * (int32_t)w;
+      uint16_t *p = GP_PixelPtr(x, y0 + sy * j, Buffer, w, h);
+      for (; n > 0; n--, p += py) {
+        *p = color;
+        if (e < dx) {
+          p += px;
+          e += dy;
+        }
+        e -= dx;
+      }
+      return;
+    }
+    for (; n > 0; n--, j++) {
+      if (x >= 0 && x < (int32_t)w)
+        *GP_PixelPtr(x, y0 + sy * j, Buffer, w, h) = color;
+      if (e < dx) {
+        x += sx;
+        e += dy;
+      }
+      e -= dx;
+    }
+  }
+}
+
+void GP_SetLines(const uint16_t *x1,
+                 const uint16_t *y1,
+                 const uint16_t *x2,
+                 const uint16_t *y2,
+                 const uint16_t *colors,
+                 uint32_t n,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h)
+{
+  const int32_t rows = GP_SHAPE_BAND * GP_BATCH_BANDS;
+
+  /* Lines are swept by bands as GP_FillRects does, each cut to the rows of
+     the band. */
+  for (uint32_t i0 = 0; i0 < n; i0 += GP_BATCH_MAX) {
+    uint32_t i1 = n - i0 < GP_BATCH_MAX ? n : i0 + GP_BATCH_MAX;
+    int32_t top = (int32_t)h, bottom = -1;
+    uint16_t m = 0;
+
+    for (uint32_t i = i0; i < i1; i++) {
+      int32_t t = y1[i] < y2[i] ? y1[i] : y2[i];
+      int32_t b = y1[i] < y2[i] ? y2[i] : y1[i];
+      if (t >= (int32_t)h || (x1[i] >= w && x2[i] >= w))
+        continue;
+      GP_BandY1[m] = t;
+      GP_BandY2[m] = b > (int32_t)h - 1 ? (int32_t)h - 1 : b;
+      if (GP_BandY1[m] < top)
+        top = GP_BandY1[m];
+      if (GP_BandY2[m] > bottom)
+        bottom = GP_BandY2[m];
+      GP_BandItem[m++] = i;
+    }
+
+    for (int32_t win = top; win <= bottom; win += rows) {
+      int32_t win_end = win + rows - 1 < bottom ? win + rows - 1 : bottom;
+      uint16_t na = 0;
+
+      GP_BandSort(m, win, win_end, GP_SHAPE_BAND);
+      for (int32_t band = win, b = 0; band <= win_end;
+           band += GP_SHAPE_BAND, b++) {
+        int32_t band_end = band + GP_SHAPE_BAND - 1 < win_end
+                               ? band + GP_SHAPE_BAND - 1
+                               : win_end;
+        uint16_t over = GP_BandNext((uint16_t)b, band_end, &na);
+
+        for (uint16_t k = 0; k < over; k++) {
+          uint16_t j = GP_BandOver[k];
+          uint32_t i = GP_BandItem[j];
+          GP_LineRows(x1[i], y1[i], x2[i], y2[i],
+                      GP_BandY1[j] > band ? GP_BandY1[j] : band,
+                      GP_BandY2[j] < band_end ? GP_BandY2[j] : band_end,
+                      colors[i], Buffer, w, h);
+        }
+      }
+    }
+  }
+}
+
+void GP_SetPixels(const uint16_t *x,
+                  const uint16_t *y,
+                  const uint16_t *colors,
+                  uint32_t n,
+                  uint16_t *Buffer,
+                  uint32_t w,
+                  uint32_t h)
+{
+  if (GP_IsRotated()) {
+    uint16_t *last = Buffer + w * h - 1;
+    for (uint32_t i = 0; i < n; i++)
+      if (x[i] < w && y[i] < h)
+        *(last - x[i] - w * y[i]) = colors[i];
+  } else {
+    for (uint32_t i = 0; i < n; i++)
+      if (x[i] < w && y[i] < h)
+        Buffer[x[i] + w * y[i]] = colors[i];
+  }
+}
+
+#define GP_CIRCLE_WIDTHS 2048 /* Row half widths of a batch of circles. */
+
+static uint16_t GP_CircleWidth[GP_CIRCLE_WIDTHS];
+static uint16_t GP_CircleFirst[GP_BATCH_MAX]; /* Width of row 0 of a circle. */
+
+/* Half widths hw[0..r] of the rows of GP_DrawFilledCircle, by its walk. */
+static void GP_CircleWidths(int32_t r, uint16_t *hw)
+{
+  int32_t x = r;
+  int32_t y = 0;
+  int32_t xChange = 1 - (r << 1);
+  int32_t yChange = 0;
+  int32_t rError = 0;
+
+  while (x >= y) {
+    hw[y] = (uint16_t)x;
+    rError += yChange;
+    yChange += 2;
+    if ((rError * 2 + xChange) > 0) {
+      if (x > y)
+        hw[x] = (uint16_t)y;
+      x--;
+      rError += xChange;
+      xChange += 2;
+    }
+    y++;
+  }
+}
+
+void GP_DrawFilledCircles(const uint16_t *x,
+                          const uint16_t *y,
+                          const uint16_t *r,
+                          const uint16_t *colors,
+                          uint32_t n,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  bool rotated = GP_IsRotated();
+  int32_t stride = rotated ? -(int32_t)w : (int32_t)w;
+  const int32_t rows = GP_SHAPE_BAND * GP_BATCH_BANDS;
+
+  /* The row widths of a batch are found once, then the circles are swept by
+     bands as GP_FillRects does. Circles too large for the width table are
+     drawn alone, in their turn. */
+  for (uint32_t i = 0; i < n;) {
+    int32_t top = (int32_t)h, bottom = -1;
+    uint32_t used = 0;
+    uint16_t m = 0;
+
+    for (; i < n && m < GP_BATCH_MAX; i++) {
+      int32_t cx = (int16_t)x[i], cy = (int16_t)y[i], cr = (int16_t)r[i];
+
+      if (cr < 0 || cy - cr >= (int32_t)h || cy + cr < 0 ||
+          cx - cr >= (int32_t)w || cx + cr < 0)
+        continue;
+      if (cr >= GP_CIRCLE_WIDTHS) {
+        if (m)
+          break;
+        GP_DrawFilledCircle(cx, cy, cr, colors[i], Buffer, w, h);
+        continue;
+      }
+      if (used + cr + 1 > GP_CIRCLE_WIDTHS)
+        break;
+      GP_CircleWidths(cr, GP_CircleWidth + used);
+      GP_CircleFirst[m] = (uint16_t)used;
+      used += cr + 1;
+      GP_BandY1[m] = cy - cr > 0 ? cy - cr : 0;
+      GP_BandY2[m] = cy + cr < (int32_t)h - 1 ? cy + cr : (int32_t)h - 1;
+      if (GP_BandY1[m] < top)
+        top = GP_BandY1[m];
+      if (GP_BandY2[m] > bottom)
+        bottom = GP_BandY2[m];
+      GP_BandItem[m++] = i;
+    }
+
+    for (int32_t win = top; win <= bottom; win += rows) {
+      int32_t win_end = win + rows - 1 < bottom ? win + rows - 1 : bottom;
+      uint16_t na = 0;
+
+      GP_BandSort(m, win, win_end, GP_SHAPE_BAND);
+      for (int32_t band = win, b = 0; band <= win_end;
+           band += GP_SHAPE_BAND, b++) {
+        int32_t band_end = band + GP_SHAPE_BAND - 1 < win_end
+                               ? band + GP_SHAPE_BAND - 1
+                               : win_end;
+        uint16_t over = GP_BandNext((uint16_t)b, band_end, &na);
+
+        for (uint16_t k = 0; k < over; k++) {
+          uint16_t j = GP_BandOver[k];
+          uint32_t c = GP_BandItem[j];
+          int32_t cx = (int16_t)x[c], cy = (int16_t)y[c];
+          int32_t y1 = GP_BandY1[j] > band ? GP_BandY1[j] : band;
+          int32_t y2 = GP_BandY2[j] < band_end ? GP_BandY2[j] : band_end;
+          const uint16_t *hw = GP_CircleWidth + GP_CircleFirst[j];
+          uint16_t *p = GP_PixelPtr(0, y1, Buffer, w, h);
+
+          for (; y1 <= y2; y1++, p += stride) {
+            int32_t d = abs(y1 - cy);
+            int32_t x1 = cx - hw[d] > 0 ? cx - hw[d] : 0;
+            int32_t x2 = cx + hw[d] < (int32_t)w ? cx + hw[d] : (int32_t)w - 1;
+            if (x1 <= x2)
+              GP_FillSpan(rotated ? p - x2 : p + x1, x2 - x1 + 1, colors[c]);
+          }
+        }
+      }
+    }
+  }
+}
+
+static inline int32_t GP_SeriesY(int16_t s,
+                                 uint16_t y,
+                                 uint16_t heigth,
+                                 int16_t min,
+                                 int16_t max)
+{
+  if (max <= min || heigth == 0)
+    return (int32_t)y + heigth - 1;
+  if (s < min)
+    s = min;
+  if (s > max)
+    s = max;
+  return (int32_t)y + heigth - 1 -
+         (int32_t)((int64_t)(s - min) * (heigth - 1) / (max - min));
+}
+
+void GP_PlotTimeSeries(uint16_t x,
+                       uint16_t y,
+                       uint16_t width,
+                       uint16_t heigth,
+                       const int16_t *Samples,
+                       uint32_t n,
+                       int16_t min,
+                       int16_t max,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  int32_t col, last, lo, hi;
+
+  if (n == 0)
+    return;
+
+  /* Every pixel column keeps only the envelope of its samples: the
+     segments inside a column cover exactly [lo, hi], the segments between
+     columns are drawn as they are. */
+  col = x;
+  last = lo = hi = GP_SeriesY(Samples[0], y, heigth, min, max);
+  for (uint32_t i = 1; i < n; i++) {
+    int32_t sx = x + (int32_t)((uint64_t)i * width / n);
+    int32_t sy = GP_SeriesY(Samples[i], y, heigth, min, max);
+
+    if (sx == col) {
+      if (sy < lo)
+        lo = sy;
+      if (sy > hi)
+        hi = sy;
+      last = sy;
+      continue;
+    }
+    GP_SetSpanV(col, lo, hi, color, Buffer, w, h);
+    GP_SetLineClipped(col, last, sx, sy, color, Buffer, w, h);
+    col = sx;
+    last = lo = hi = sy;
+  }
+  GP_SetSpanV(col, lo, hi, color, Buffer, w, h);
+}
+
+/* tan() of 0..45 degrees, Q16. */
+static const uint32_t GP_Tan[46] = {
+    0, 1144, 2289, 3435, 4583, 5734, 6888, 8047,
+    9210, 10380, 11556, 12739, 13930, 15130, 16340, 17560,
+    18792, 20036, 21294, 22566, 23853, 25157, 26478, 27818,
+    29179, 30560, 31964, 33392, 34846, 36327, 37837, 39378,
+    40951, 42560, 44205, 45889, 47615, 49385, 51202, 53070,
+    54991, 56970, 59009, 61113, 63287, 65536};
+
+/* Angle of an octant (in GP_Octant order) is base + sign * atan(x / y). */
+static const int16_t GP_OctantAngle[8][2] = {
+    {90, -1}, {0, 1},    {360, -1}, {270, 1},
+    {270, -1}, {180, 1}, {180, -1}, {90, 1}};
+
+/* First offset with atan(x / y) >= d degrees, or n. */
+static uint16_t GP_OctantFind(const uint16_t *ox,
+                              const uint16_t *oy,
+                              uint16_t n,
+                              uint8_t d,
+                              bool after)
+{
+  uint16_t lo = 0, hi = n;
+
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    uint64_t x = (uint64_t)ox[mid] << 16, y = (uint64_t)oy[mid] * GP_Tan[d];
+    if (after ? x > y : x >= y)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+/*
+ * Plots the part of octant offsets ox/oy that lies in the angles a1..a2
+ * (0 <= a1 <= a2 <= 360, degrees counterclockwise from the east).
+ */
+static void GP_PlotArcOctants(int32_t cx,
+                              int32_t cy,
+                              const uint16_t *ox,
+                              const uint16_t *oy,
+                              uint16_t n,
+                              int16_t a1,
+                              int16_t a2,
+                              uint16_t color,
+                              uint16_t *Buffer,
+                              uint32_t w,
+                              uint32_t h)
+{
+  for (uint8_t k = 0; k < 8; k++) {
+    int16_t base = GP_OctantAngle[k][0], sign = GP_OctantAngle[k][1];
+    int16_t lo = sign > 0 ? base : base - 45;
+    int16_t hi = lo + 45;
+    int16_t d1, d2;
+    uint16_t i1, i2;
+
+    if (a2 < lo || a1 > hi)
+      continue;
+    if (a1 <= lo && a2 >= hi) {
+      GP_PlotOctants(cx, cy, ox, oy, n, 1 << k, color, Buffer, w, h);
+      continue;
+    }
+
+    /* Angles inside the octant, as atan(x / y) of the offsets. */
+    if (sign > 0) {
+      d1 = (a1 > lo ? a1 : lo) - base;
+      d2 = (a2 < hi ? a2 : hi) - base;
+    } else {
+      d1 = base - (a2 < hi ? a2 : hi);
+      d2 = base - (a1 > lo ? a1 : lo);
+    }
+    i1 = GP_OctantFind(ox, oy, n, (uint8_t)d1, false);
+    i2 = GP_OctantFind(ox, oy, n, (uint8_t)d2, true);
+    if (i1 < i2)
+      GP_PlotOctants(cx, cy, ox + i1, oy + i1, i2 - i1, 1 << k, color, Buffer,
+                     w, h);
+  }
+}
+
+void GP_SetArc(uint16_t x,
+               uint16_t y,
+               uint16_t a1,
+               uint16_t a2,
+               uint16_t r,
+               uint16_t color,
+               uint16_t *Buffer,
+               uint32_t w,
+               uint32_t h)
+{
+  const GP_CIRCLE_OCTANT *c = GP_CircleOctant(r);
+  uint16_t ox[GP_CIRCLE_OCTANT_MAX], oy[GP_CIRCLE_OCTANT_MAX], n;
+  int16_t from = a1 % 360, to;
+  GP_CIRCLE_WALK cw;
+
+  if (a2 == a1)
+    return;
+  if (a2 >= a1 + 360) {
+    GP_DrawOctants(x, y, r, 0xFF, color, Buffer, w, h);
+    return;
+  }
+  to = from + (int16_t)((a2 + 360 - from) % 360);
+  if (to == from)
+    to += 360;
+
+  GP_CircleWalkInit(&cw, r);
+  do {
+    const uint16_t *px = ox, *py = oy;
+    if (c != NULL) {
+      px = c->x;
+      py = c->y;
+      n = c->n;
+    } else {
+      n = GP_CircleWalkNext(&cw, ox, oy, GP_CIRCLE_OCTANT_MAX);
+    }
+    if (to > 360) {
+      GP_PlotArcOctants(x, y, px, py, n, from, 360, color, Buffer, w, h);
+      GP_PlotArcOctants(x, y, px, py, n, 0, to - 360, color, Buffer, w, h);
+    } else {
+      GP_PlotArcOctants(x, y, px, py, n, from, to, color, Buffer, w, h);
+    }
+  } while (c == NULL && n != 0);
+}
+
+/**
+ *	Annular sectors. A row of a sector is the row of its ring cut by the two
+ *	half planes of the start and end rays, so spans are found directly.
+ */
+
+#define GP_ANGLE_ONE 16
+#define GP_ANGLE_FULL (360 * GP_ANGLE_ONE)
+#define GP_WEDGE_INF (1 << 24)
+#define GP_WEDGE_HALF (1 << 13) /* Half a pixel, Q14. */
+
+/* sin() of 0..90 degrees, Q14. */
+static const int16_t GP_Sin[91] = {
+    0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+    2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+    5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+    8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384};
+
+/* sin() of an angle in 1/GP_ANGLE_ONE degrees, Q14. */
+static int32_t GP_SinFix(int32_t a)
+{
+  int32_t s = 1, i, f, v;
+
+  a %= GP_ANGLE_FULL;
+  if (a < 0)
+    a += GP_ANGLE_FULL;
+  if (a >= GP_ANGLE_FULL / 2) {
+    a -= GP_ANGLE_FULL / 2;
+    s = -1;
+  }
+  if (a > GP_ANGLE_FULL / 4)
+    a = GP_ANGLE_FULL / 2 - a;
+  i = a / GP_ANGLE_ONE;
+  f = a % GP_ANGLE_ONE;
+  v = GP_Sin[i];
+  if (f != 0)
+    v += (GP_Sin[i + 1] - GP_Sin[i]) * f / GP_ANGLE_ONE;
+  return s * v;
+}
+
+/*
+ * Wedge between the rays at angles a1..a2. A point (dx, v), v pointing up,
+ * is on the inner side of edge i when a[i] * dx + b[i] * v >= 0 (Q14, the
+ * distance to the edge line). Wedges up to 180 degrees are inside both
+ * edges, wider ones inside either.
+ */
+typedef struct gp_wedge {
+  int32_t a[2];
+  int32_t b[2];
+  uint8_t mode;
+} GP_WEDGE;
+
+#define GP_WEDGE_FULL 0
+#define GP_WEDGE_BOTH 1
+#define GP_WEDGE_EITHER 2
+
+/* a1 <= a2 <= a1 + GP_ANGLE_FULL, in 1/GP_ANGLE_ONE degrees. */
+static void GP_WedgeInit(GP_WEDGE *wg, int32_t a1, int32_t a2)
+{
+  wg->a[0] = -GP_SinFix(a1);
+  wg->b[0] = GP_SinFix(a1 + GP_ANGLE_FULL / 4);
+  wg->a[1] = GP_SinFix(a2);
+  wg->b[1] = -GP_SinFix(a2 + GP_ANGLE_FULL / 4);
+  if (a2 - a1 >= GP_ANGLE_FULL)
+    wg->mode = GP_WEDGE_FULL;
+  else if (a2 - a1 > GP_ANGLE_FULL / 2)
+    wg->mode = GP_WEDGE_EITHER;
+  else
+    wg->mode = GP_WEDGE_BOTH;
+}
+
+static int64_t GP_FloorDiv(int64_t n, int64_t d)
+{
+  int64_t q = n / d;
+
+  if (n % d != 0 && (n < 0) != (d < 0))
+    q--;
+  return q;
+}
+
+/* Offsets dx with a * dx + c >= 0, as lo..hi (empty when lo > hi). */
+static void GP_HalfPlaneRow(int32_t a, int64_t c, int32_t *lo, int32_t *hi)
+{
+  int64_t l = -GP_WEDGE_INF, r = GP_WEDGE_INF;
+
+  if (a > 0)
+    l = -GP_FloorDiv(c, a);
+  else if (a < 0)
+    r = GP_FloorDiv(c, -a);
+  else if (c < 0)
+    l = GP_WEDGE_INF;
+  if (l < -GP_WEDGE_INF)
+    l = -GP_WEDGE_INF;
+  if (r > GP_WEDGE_INF)
+    r = GP_WEDGE_INF;
+  *lo = (int32_t)(l > GP_WEDGE_INF ? GP_WEDGE_INF : l);
+  *hi = (int32_t)(r < -GP_WEDGE_INF ? -GP_WEDGE_INF : r);
+}
+
+/*
+ * Offsets dx of row v whose distance to the start edge is at least off and
+ * to the end edge at least off_end (Q14), as up to two sorted intervals in
+ * iv. Returns the interval count.
+ */
+static uint8_t GP_WedgeRow(const GP_WEDGE *wg,
+                           int32_t v,
+                           int32_t off,
+                           int32_t off_end,
+                           int32_t *iv)
+{
+  int32_t l0, h0, l1, h1;
+
+  if (wg->mode == GP_WEDGE_FULL) {
+    iv[0] = -GP_WEDGE_INF;
+    iv[1] = GP_WEDGE_INF;
+    return 1;
+  }
+  GP_HalfPlaneRow(wg->a[0], (int64_t)wg->b[0] * v - off, &l0, &h0);
+  GP_HalfPlaneRow(wg->a[1], (int64_t)wg->b[1] * v - off_end, &l1, &h1);
+
+  if (wg->mode == GP_WEDGE_BOTH) {
+    iv[0] = l0 > l1 ? l0 : l1;
+    iv[1] = h0 < h1 ? h0 : h1;
+    return iv[0] <= iv[1] ? 1 : 0;
+  }
+
+  if (l0 > h0) {
+    l0 = l1;
+    h0 = h1;
+  } else if (l1 <= h1 && l1 < l0) {
+    int32_t t = l0;
+    l0 = l1;
+    l1 = t;
+    t = h0;
+    h0 = h1;
+    h1 = t;
+  }
+  if (l0 > h0)
+    return 0;
+  iv[0] = l0;
+  iv[1] = h0;
+  if (l1 > h1 || (l1 == l0 && h1 == h0))
+    return 1;
+  if (l1 <= h0 + 1) {
+    if (h1 > iv[1])
+      iv[1] = h1;
+    return 1;
+  }
+  iv[2] = l1;
+  iv[3] = h1;
+  return 2;
+}
+
+/* Offsets k1 <= |dx| <= k2 as up to two sorted intervals. */
+static uint8_t GP_RadialRow(int32_t k1, int32_t k2, int32_t *iv)
+{
+  if (k1 > k2)
+    return 0;
+  if (k1 == 0) {
+    iv[0] = -k2;
+    iv[1] = k2;
+    return 1;
+  }
+  iv[0] = -k2;
+  iv[1] = -k1;
+  iv[2] = k1;
+  iv[3] = k2;
+  return 2;
+}
+
+/* Intersection of two sorted interval lists, up to na + nb intervals. */
+static uint8_t GP_IntersectRow(const int32_t *a,
+                               uint8_t na,
+                               const int32_t *b,
+                               uint8_t nb,
+                               int32_t *out)
+{
+  uint8_t i = 0, j = 0, n = 0;
+
+  while (i < na && j < nb) {
+    int32_t lo = a[2 * i] > b[2 * j] ? a[2 * i] : b[2 * j];
+    int32_t hi = a[2 * i + 1] < b[2 * j + 1] ? a[2 * i + 1] : b[2 * j + 1];
+    if (lo <= hi) {
+      out[2 * n] = lo;
+      out[2 * n + 1] = hi;
+      n++;
+    }
+    if (a[2 * i + 1] < b[2 * j + 1])
+      i++;
+    else
+      j++;
+  }
+  return n;
+}
+
+/* Coverage of the wedge edges at (dx, v). */
+static uint8_t GP_WedgeCoverage(const GP_WEDGE *wg, int32_t dx, int32_t v)
+{
+  int32_t c0, c1;
+
+  if (wg->mode == GP_WEDGE_FULL)
+    return 255;
+  c0 = ((wg->a[0] * dx + wg->b[0] * v) >> 6) + 128;
+  c1 = ((wg->a[1] * dx + wg->b[1] * v) >> 6) + 128;
+  if (wg->mode == GP_WEDGE_BOTH ? c1 < c0 : c1 > c0)
+    c0 = c1;
+  return c0 <= 0 ? 0 : c0 >= 255 ? 255 : (uint8_t)c0;
+}
+
+/*
+ * Draws row dy of the sector of radiuses ri..ro in wedge wg centered at
+ * (x0, y0). Anti-aliased rows draw the solid runs by spans and blend the
+ * pixels in between.
+ */
+static void GP_SectorRow(int32_t x0,
+                         int32_t y0,
+                         int32_t dy,
+                         int32_t ro,
+                         int32_t ri,
+                         const GP_WEDGE *wg,
+                         bool aa,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  int32_t e[4], rad[4], wed[4], in[8], out[8], y = y0 + dy;
+  uint8_t nr, nw, nin, nout, j = 0;
+
+  if (y < 0 || y >= (int32_t)h || !GP_RingBounds(dy, ro, ri, e))
+    return;
+
+  nr = GP_RadialRow(e[2], e[3], rad);
+  nw = GP_WedgeRow(wg, -dy, aa ? GP_WEDGE_HALF : 0, aa ? GP_WEDGE_HALF : 0,
+                   wed);
+  nin = GP_IntersectRow(rad, nr, wed, nw, in);
+  if (!aa) {
+    for (uint8_t i = 0; i < nin; i++)
+      GP_SetSpanH(x0 + in[2 * i], x0 + in[2 * i + 1], y, color, Buffer, w, h);
+    return;
+  }
+
+  /* Pixels within half a pixel outside of every edge get some coverage. */
+  nr = GP_RadialRow(e[0], e[1], rad);
+  nw = GP_WedgeRow(wg, -dy, 1 - GP_WEDGE_HALF, 1 - GP_WEDGE_HALF, wed);
+  nout = GP_IntersectRow(rad, nr, wed, nw, out);
+  for (uint8_t i = 0; i < nout; i++) {
+    int32_t k = out[2 * i] > -x0 ? out[2 * i] : -x0;
+    int32_t end = out[2 * i + 1] < (int32_t)w - 1 - x0 ? out[2 * i + 1]
+                                                        : (int32_t)w - 1 - x0;
+    while (k <= end) {
+      while (j < nin && in[2 * j + 1] < k)
+        j++;
+      if (j < nin && in[2 * j] <= k) {
+        int32_t s = in[2 * j + 1] < end ? in[2 * j + 1] : end;
+        GP_SetSpanH(x0 + k, x0 + s, y, color, Buffer, w, h);
+        k = s + 1;
+      } else {
+        uint8_t c = GP_RingCoverage(k < 0 ? -k : k, dy, ro, ri);
+        uint8_t cw = GP_WedgeCoverage(wg, k, -dy);
+        GP_BlendPixel(x0 + k, y, color, c < cw ? c : cw, Buffer, w, h);
+        k++;
+      }
+    }
+  }
+}
+
+/* Sector of radiuses ri..ro between angles a1 <= a2 <= a1 + GP_ANGLE_FULL. */
+static void GP_FillSector(int32_t x0,
+                          int32_t y0,
+                          int32_t ri,
+                          int32_t ro,
+                          int32_t a1,
+                          int32_t a2,
+                          bool aa,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  GP_WEDGE wg;
+  int32_t top = y0 - ro > 0 ? y0 - ro : 0;
+  int32_t bottom = y0 + ro < (int32_t)h - 1 ? y0 + ro : (int32_t)h - 1;
+
+  if (ro < 0 || ri > ro || a2 <= a1)
+    return;
+  GP_WedgeInit(&wg, a1, a2);
+  for (int32_t y = top; y <= bottom; y++)
+    GP_SectorRow(x0, y0, y - y0, ro, ri, &wg, aa, color, Buffer, w, h);
+}
+
+void GP_FillArcSegment(uint16_t x,
+                       uint16_t y,
+                       uint16_t r_inner,
+                       uint16_t r_outer,
+                       uint16_t a1,
+                       uint16_t a2,
+                       bool aa,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  int32_t from = a1 % 360, to;
+
+  if (a2 == a1)
+    return;
+  if (a2 >= a1 + 360) {
+    to = from + 360;
+  } else {
+    to = from + (a2 + 360 - from) % 360;
+    if (to == from)
+      to += 360;
+  }
+  GP_FillSector(x, y, r_inner, r_outer, from * GP_ANGLE_ONE, to * GP_ANGLE_ONE,
+                aa, color, Buffer, w, h);
+}
+
+#define GP_PIE_CHUNK 32 /* Slices whose wedges are set up at once. */
+
+static GP_WEDGE GP_PieWedges[2 * GP_PIE_CHUNK];
+static uint16_t GP_PieColors[2 * GP_PIE_CHUNK];
+
+/*
+ * Sets up the wedges of slices k0..k1 - 1 from angle *a1 on, returns their
+ * number. The start ray belongs to the slice, the end ray does not. Slices
+ * of 180 degrees and more are split, their edges would lie on one line.
+ */
+static uint8_t GP_PieWedgesInit(const uint16_t *values,
+                                const uint16_t *colors,
+                                uint32_t k0,
+                                uint32_t k1,
+                                int32_t a0,
+                                uint64_t total,
+                                uint64_t *sum,
+                                int32_t *a1)
+{
+  uint8_t nw = 0;
+
+  for (uint32_t k = k0; k < k1; k++) {
+    int32_t a2;
+
+    *sum += values[k];
+    a2 = a0 + (int32_t)(*sum * GP_ANGLE_FULL / total);
+    if (a2 - *a1 >= GP_ANGLE_FULL / 2 && a2 - *a1 < GP_ANGLE_FULL) {
+      int32_t mid = *a1 + (a2 - *a1) / 2;
+      GP_PieColors[nw] = colors[k];
+      GP_WedgeInit(&GP_PieWedges[nw++], *a1, mid);
+      GP_PieColors[nw] = colors[k];
+      GP_WedgeInit(&GP_PieWedges[nw++], mid, a2);
+    } else if (a2 != *a1) {
+      GP_PieColors[nw] = colors[k];
+      GP_WedgeInit(&GP_PieWedges[nw++], *a1, a2);
+    }
+    *a1 = a2;
+  }
+  return nw;
+}
+
+void GP_FillPie(uint16_t x,
+                uint16_t y,
+                uint16_t r_inner,
+                uint16_t r_outer,
+                uint16_t start,
+                const uint16_t *values,
+                const uint16_t *colors,
+                uint32_t n,
+                uint16_t *Buffer,
+                uint32_t w,
+                uint32_t h)
+{
+  int32_t top = y - r_outer > 0 ? y - r_outer : 0;
+  int32_t bottom = y + r_outer < (int32_t)h - 1 ? y + r_outer : (int32_t)h - 1;
+  int32_t a0 = (start % 360) * GP_ANGLE_ONE, a1 = a0;
+  uint64_t total = 0, sum = 0;
+  uint32_t first = n;
+
+  for (uint32_t i = 0; i < n; i++) {
+    if (first == n && values[i] != 0)
+      first = i;
+    total += values[i];
+  }
+  if (total == 0 || r_inner > r_outer)
+    return;
+
+  /* The center is on every edge, it goes to the first slice. */
+  if (r_inner == 0)
+    GP_SetSpanH(x, x, y, colors[first], Buffer, w, h);
+
+  /*
+   * The wedges of a chunk of slices are set up once, then the rows are drawn
+   * one by one, each wedge cut from the ring row. A pixel on a boundary ray
+   * belongs to the slice that starts there only, so slices never overlap.
+   */
+  for (uint32_t k0 = 0; k0 < n; k0 += GP_PIE_CHUNK) {
+    uint32_t k1 = n - k0 < GP_PIE_CHUNK ? n : k0 + GP_PIE_CHUNK;
+    uint8_t nw =
+        GP_PieWedgesInit(values, colors, k0, k1, a0, total, &sum, &a1);
+
+    for (int32_t i = top; i <= bottom && nw; i++) {
+      int32_t dy = i - y, e[4], rad[4], wed[4], sp[8];
+      uint8_t nr;
+
+      if (!GP_RingBounds(dy, r_outer, r_inner, e))
+        continue;
+      nr = GP_RadialRow(e[2], e[3], rad);
+      for (uint8_t k = 0; k < nw; k++) {
+        uint8_t ns = GP_WedgeRow(&GP_PieWedges[k], -dy, 0, 1, wed);
+
+        ns = GP_IntersectRow(rad, nr, wed, ns, sp);
+        for (uint8_t j = 0; j < ns; j++)
+          GP_SetSpanH(x + sp[2 * j], x + sp[2 * j + 1], i, GP_PieColors[k],
+                      Buffer, w, h);
+      }
+    }
+  }
+}
+
+/**
+ *	Polygon fill. Edges are sorted by their first row and moved into a sorted
+ *	active edge table while the rows are scanned; x of active edges is stepped
+ *	in Q32 with slopes rounded down, which keeps ceil(x) exact for any edge of
+ *	16 bit coordinates. A pixel is filled when its center is inside, so
+ *	polygons sharing an edge do not overlap.
+ */
+
+#define GP_POLYGON_MAX_EDGES 256
+
+typedef struct gp_edge {
+  int32_t y1, y2; /* Rows y1..y2 - 1. */
+  int64_t x, dx;  /* x at the current row and per row, Q32. */
+  int8_t dir;     /* 1 going down, -1 going up. */
+} GP_EDGE;
+
+static GP_EDGE GP_Edges[GP_POLYGON_MAX_EDGES];
+static uint16_t GP_ActiveEdges[GP_POLYGON_MAX_EDGES];
+
+void GP_FillPolygon(const uint16_t *x,
+                    const uint16_t *y,
+                    uint16_t n,
+                    uint8_t rule,
+                    uint16_t color,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h)
+{
+  uint16_t ne = 0, na = 0, next = 0;
+  int32_t end = 0;
+
+  if (n < 3 || n > GP_POLYGON_MAX_EDGES)
+    return;
+
+  /* Edge table, sorted by the first row. */
+  for (uint16_t i = 0; i < n; i++) {
+    uint16_t j = i + 1 < n ? i + 1 : 0, t = i, b = j;
+    GP_EDGE e;
+    uint16_t k;
+
+    if (y[i] == y[j])
+      continue;
+    e.dir = 1;
+    if (y[i] > y[j]) {
+      t = j;
+      b = i;
+      e.dir = -1;
+    }
+    e.y1 = y[t];
+    e.y2 = y[b];
+    e.dx = GP_FloorDiv(((int64_t)x[b] - x[t]) * ((int64_t)1 << 32),
+                       e.y2 - e.y1);
+    e.x = (int64_t)x[t] << 32;
+    if (e.y2 > end)
+      end = e.y2;
+    for (k = ne; k > 0 && GP_Edges[k - 1].y1 > e.y1; k--)
+      GP_Edges[k] = GP_Edges[k - 1];
+    GP_Edges[k] = e;
+    ne++;
+  }
+  if (end > (int32_t)h)
+    end = (int32_t)h;
+
+  for (int32_t row = ne ? GP_Edges[0].y1 : end; row < end; row++) {
+    int32_t wind = 0;
+    uint16_t m = 0;
+
+    while (next < ne && GP_Edges[next].y1 <= row)
+      GP_ActiveEdges[na++] = next++;
+
+    /* Drop finished edges, keep the rest sorted by x. */
+    for (uint16_t i = 0; i < na; i++) {
+      uint16_t a = GP_ActiveEdges[i], k;
+      if (GP_Edges[a].y2 <= row)
+        continue;
+      for (k = m; k > 0 && GP_Edges[GP_ActiveEdges[k - 1]].x > GP_Edges[a].x;
+           k--)
+        GP_ActiveEdges[k] = GP_ActiveEdges[k - 1];
+      GP_ActiveEdges[k] = a;
+      m++;
+    }
+    na = m;
+
+    for (uint16_t i = 0; i + 1 < na; i++) {
+      const GP_EDGE *e = &GP_Edges[GP_ActiveEdges[i]];
+      const GP_EDGE *f = &GP_Edges[GP_ActiveEdges[i + 1]];
+      bool inside;
+
+      wind += rule == GP_FILL_NON_ZERO ? e->dir : 1;
+      inside = rule == GP_FILL_NON_ZERO ? wind != 0 : (wind & 1) != 0;
+      if (inside) {
+        int64_t l = (e->x + 0xFFFFFFFF) >> 32;
+        int64_t r = ((f->x + 0xFFFFFFFF) >> 32) - 1;
+        if (l <= r)
+          GP_SetSpanH((int32_t)l, (int32_t)r, row, color, Buffer, w, h);
+      }
+    }
+    for (uint16_t i = 0; i < na; i++)
+      GP_Edges[GP_ActiveEdges[i]].x += GP_Edges[GP_ActiveEdges[i]].dx;
+  }
+}
+
+/**
+ *	Triangle meshes. Triangles are set up once per batch and sorted by their
+ *	first band of one block row (a stable counting sort), then the bands are
+ *	swept with a list of the triangles over the band, in their order. Each
+ *	triangle is walked by GP_TRI_BLOCK square blocks. The edge functions at
+ *	the block corners tell whether a block is outside, fully inside (filled
+ *	by spans without tests) or partly covered, then every row of the block
+ *	is tested for all its pixels at once. Edges that are not top or left
+ *	edges are biased by -1, so pixels on an edge shared by two triangles are
+ *	drawn once.
+ */
+
+#define GP_TRI_BLOCK 8
+#define GP_TRI_SIMD_MAX (1 << 14) /* Max edge extent for 32 bit tests, 1/16 px. */
+
+typedef struct gp_tri {
+  int64_t a[3], b[3], c[3]; /* Edge k at pixel (x, y) is a*x + b*y + c. */
+  int32_t x1, y1, x2, y2;   /* Pixels of the bounding box, inclusive. */
+  bool small;               /* Edges fit 32 bits around the triangle. */
+} GP_TRI;
+
+/* Sets up triangle x/y (1/16 pixel). Returns false when it has no area. */
+static bool GP_TriSetup(GP_TRI *t, const int32_t *x, const int32_t *y)
+{
+  int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) -
+                 (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+  uint8_t o1 = 1, o2 = 2;
+  int32_t ext = 0;
+
+  if (area == 0)
+    return false;
+  if (area < 0) {
+    o1 = 2;
+    o2 = 1;
+  }
+
+  for (uint8_t k = 0; k < 3; k++) {
+    uint8_t i = k == 0 ? 0 : k == 1 ? o1 : o2;
+    uint8_t j = k == 0 ? o1 : k == 1 ? o2 : 0;
+    int32_t dx = x[j] - x[i], dy = y[j] - y[i];
+    bool top_left = dy < 0 || (dy == 0 && dx > 0);
+
+    t->a[k] = -(int64_t)dy * 16;
+    t->b[k] = (int64_t)dx * 16;
+    t->c[k] = (int64_t)dy * x[i] - (int64_t)dx * y[i] - (top_left ? 0 : 1);
+    if (abs(dx) > ext)
+      ext = abs(dx);
+    if (abs(dy) > ext)
+      ext = abs(dy);
+  }
+  t->small = ext < GP_TRI_SIMD_MAX;
+
+  t->x1 = t->x2 = x[0];
+  t->y1 = t->y2 = y[0];
+  for (uint8_t k = 1; k < 3; k++) {
+    if (x[k] < t->x1)
+      t->x1 = x[k];
+    if (x[k] > t->x2)
+      t->x2 = x[k];
+    if (y[k] < t->y1)
+      t->y1 = y[k];
+    if (y[k] > t->y2)
+      t->y2 = y[k];
+  }
+  t->x1 = (t->x1 + 15) >> 4;
+  t->y1 = (t->y1 + 15) >> 4;
+  t->x2 >>= 4;
+  t->y2 >>= 4;
+  return t->x1 <= t->x2 && t->y1 <= t->y2;
+}
+
+/* Pixels of a block row inside all edges, bit i for pixel i. */
+static uint8_t GP_TriRowMask(const GP_TRI *t, const int64_t *e)
+{
+  uint8_t m = 0;
+
+#if defined(__SSE2__)
+  if (t->small) {
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    for (uint8_t k = 0; k < 3; k++) {
+      int32_t a = (int32_t)t->a[k], v = (int32_t)e[k];
+      __m128i s = _mm_set_epi32(3 * a, 2 * a, a, 0);
+      __m128i b = _mm_add_epi32(_mm_set1_epi32(v), s);
+      lo = _mm_or_si128(lo, b);
+      hi = _mm_or_si128(hi, _mm_add_epi32(b, _mm_set1_epi32(4 * a)));
+    }
+    m = (uint8_t)(_mm_movemask_ps(_mm_castsi128_ps(lo)) |
+                  (_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4));
+    return (uint8_t)~m;
+  }
+#endif
+  for (uint8_t i = 0; i < GP_TRI_BLOCK; i++)
+    if (e[0] + i * t->a[0] >= 0 && e[1] + i * t->a[1] >= 0 &&
+        e[2] + i * t->a[2] >= 0)
+      m |= 1 << i;
+  return m;
+}
+
+/* Draws the part of triangle t in block row by0 (clipped to y1..y2). */
+static void GP_TriBand(const GP_TRI *t,
+                       int32_t by0,
+                       int32_t y1,
+                       int32_t y2,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  int32_t x1 = t->x1 > 0 ? t->x1 : 0;
+  int32_t x2 = t->x2 < (int32_t)w - 1 ? t->x2 : (int32_t)w - 1;
+  const int32_t d = GP_TRI_BLOCK - 1;
+
+  if (t->y1 > y1)
+    y1 = t->y1;
+  if (t->y2 < y2)
+    y2 = t->y2;
+  if (y1 > y2)
+    return;
+
+  for (int32_t bx = x1 & ~d; bx <= x2; bx += GP_TRI_BLOCK) {
+    int64_t e[3];
+    bool full = true, out = false;
+
+    for (uint8_t k = 0; k < 3; k++) {
+      int64_t ax = t->a[k] * d, ay = t->b[k] * d;
+      e[k] = t->a[k] * bx + t->b[k] * by0 + t->c[k];
+      if (e[k] + (ax > 0 ? ax : 0) + (ay > 0 ? ay : 0) < 0)
+        out = true;
+      if (e[k] + (ax < 0 ? ax : 0) + (ay < 0 ? ay : 0) < 0)
+        full = false;
+    }
+    if (out)
+      continue;
+    if (full) {
+      for (int32_t y = y1; y <= y2; y++)
+        GP_SetSpanH(bx, bx + d, y, color, Buffer, w, h);
+      continue;
+    }
+
+    for (uint8_t k = 0; k < 3; k++)
+      e[k] += t->b[k] * (y1 - by0);
+    for (int32_t y = y1; y <= y2; y++) {
+      uint8_t m = GP_TriRowMask(t, e);
+      if (m != 0) {
+        int32_t i1 = 0, i2 = d;
+        while (!(m & (1 << i1)))
+          i1++;
+        while (!(m & (1 << i2)))
+          i2--;
+        GP_SetSpanH(bx + i1, bx + i2, y, color, Buffer, w, h);
+      }
+      for (uint8_t k = 0; k < 3; k++)
+        e[k] += t->b[k];
+    }
+  }
+}
+
+static GP_TRI GP_TriBatch[GP_BATCH_MAX];
+
+/* Draws batch triangles 0..m - 1 over rows top..bottom. */
+static void GP_TriSweep(uint16_t m,
+                        int32_t top,
+                        int32_t bottom,
+                        const uint16_t *colors,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h)
+{
+  const int32_t rows = GP_TRI_BLOCK * GP_BATCH_BANDS;
+
+  for (int32_t win = top & ~(GP_TRI_BLOCK - 1); win <= bottom; win += rows) {
+    int32_t win_end = win + rows - 1 < bottom ? win + rows - 1 : bottom;
+    uint16_t na = 0;
+
+    GP_BandSort(m, win, win_end, GP_TRI_BLOCK);
+    for (int32_t band = win, b = 0; band <= win_end;
+         band += GP_TRI_BLOCK, b++) {
+      int32_t band_end = band + GP_TRI_BLOCK - 1 < win_end
+                             ? band + GP_TRI_BLOCK - 1
+                             : win_end;
+      uint16_t over = GP_BandNext((uint16_t)b, band_end, &na);
+
+      for (uint16_t k = 0; k < over; k++) {
+        uint16_t j = GP_BandOver[k];
+        GP_TriBand(&GP_TriBatch[j], band, band, band_end,
+                   colors[GP_BandItem[j]], Buffer, w, h);
+      }
+    }
+  }
+}
+
+void GP_FillTriangles(const int16_t *x,
+                      const int16_t *y,
+                      const uint16_t *index,
+                      const uint16_t *colors,
+                      uint32_t n,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h)
+{
+  for (uint32_t i0 = 0; i0 < n; i0 += GP_BATCH_MAX) {
+    uint32_t i1 = n - i0 < GP_BATCH_MAX ? n : i0 + GP_BATCH_MAX;
+    int32_t top = (int32_t)h, bottom = -1;
+    uint16_t m = 0;
+
+    for (uint32_t i = i0; i < i1; i++) {
+      const uint16_t *v = index + 3 * i;
+      int32_t px[3] = {x[v[0]], x[v[1]], x[v[2]]};
+      int32_t py[3] = {y[v[0]], y[v[1]], y[v[2]]};
+      GP_TRI *t = &GP_TriBatch[m];
+
+      if (!GP_TriSetup(t, px, py))
+        continue;
+      /* Rows are clipped here, GP_TriBand clips the columns. */
+      if (t->y1 < 0)
+        t->y1 = 0;
+      if (t->y2 > (int32_t)h - 1)
+        t->y2 = (int32_t)h - 1;
+      if (t->y1 > t->y2)
+        continue;
+      if (t->y1 < top)
+        top = t->y1;
+      if (t->y2 > bottom)
+        bottom = t->y2;
+      GP_BandY1[m] = t->y1;
+      GP_BandY2[m] = t->y2;
+      GP_BandItem[m++] = i;
+    }
+    GP_TriSweep(m, top, bottom, colors, Buffer, w, h);
+  }
+}
+
+/**
+ *	Shaded triangles. R, G and B are planes over the triangle in Q16 of
+ *	0..255, stepped by a constant per pixel along each span; pixels are
+ *	packed to RGB565 with a 4x4 Bayer dither. Spans follow the rule of
+ *	GP_FillTriangles, so shaded and flat meshes fit together.
+ */
+
+static const uint8_t GP_Bayer[4][4] = {
+    {0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+static inline int32_t GP_Clamp8(int32_t v)
+{
+  return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+#if defined(__SSE2__)
+/* Four pixels of channels r, g, b plus dither tr, tg, as 32 bit RGB565. */
+static inline __m128i GP_Shade4(__m128i r,
+                                __m128i g,
+                                __m128i b,
+                                __m128i tr,
+                                __m128i tg)
+{
+  const __m128i max = _mm_set1_epi32(255);
+  __m128i c[3];
+
+  c[0] = _mm_srai_epi32(_mm_add_epi32(r, tr), 16);
+  c[1] = _mm_srai_epi32(_mm_add_epi32(g, tg), 16);
+  c[2] = _mm_srai_epi32(_mm_add_epi32(b, tr), 16);
+  for (int i = 0; i < 3; i++) {
+    __m128i m;
+    c[i] = _mm_andnot_si128(_mm_srai_epi32(c[i], 31), c[i]);
+    m = _mm_cmpgt_epi32(c[i], max);
+    c[i] = _mm_or_si128(_mm_and_si128(m, max), _mm_andnot_si128(m, c[i]));
+  }
+  return _mm_or_si128(
+      _mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(c[0], 3), 11),
+                   _mm_slli_epi32(_mm_srli_epi32(c[1], 2), 5)),
+      _mm_srli_epi32(c[2], 3));
+}
+#endif
+
+/*
+ * Writes n pixels shaded from c (r, g, b) by dc per pixel. d holds the
+ * Bayer thresholds of the first four pixels, the pattern repeats after them.
+ */
+static void GP_ShadeSpan(uint16_t *p,
+                         uint32_t n,
+                         const int32_t *c,
+                         const int32_t *dc,
+                         const uint8_t *d)
+{
+  int32_t r = c[0], g = c[1], b = c[2];
+  uint32_t i = 0;
+
+#if defined(__SSE2__)
+  __m128i tr = _mm_set_epi32(d[3] << 15, d[2] << 15, d[1] << 15, d[0] << 15);
+  __m128i tg = _mm_set_epi32(d[3] << 14, d[2] << 14, d[1] << 14, d[0] << 14);
+  __m128i vr = _mm_set_epi32(r + 3 * dc[0], r + 2 * dc[0], r + dc[0], r);
+  __m128i vg = _mm_set_epi32(g + 3 * dc[1], g + 2 * dc[1], g + dc[1], g);
+  __m128i vb = _mm_set_epi32(b + 3 * dc[2], b + 2 * dc[2], b + dc[2], b);
+  __m128i sr = _mm_set1_epi32(4 * dc[0]);
+  __m128i sg = _mm_set1_epi32(4 * dc[1]);
+  __m128i sb = _mm_set1_epi32(4 * dc[2]);
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i lo = GP_Shade4(vr, vg, vb, tr, tg), hi;
+    vr = _mm_add_epi32(vr, sr);
+    vg = _mm_add_epi32(vg, sg);
+    vb = _mm_add_epi32(vb, sb);
+    hi = GP_Shade4(vr, vg, vb, tr, tg);
+    vr = _mm_add_epi32(vr, sr);
+    vg = _mm_add_epi32(vg, sg);
+    vb = _mm_add_epi32(vb, sb);
+    /* Sign extension keeps _mm_packs_epi32 from saturating. */
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    _mm_storeu_si128((__m128i *)(p + i), _mm_packs_epi32(lo, hi));
+  }
+  r += (int32_t)i * dc[0];
+  g += (int32_t)i * dc[1];
+  b += (int32_t)i * dc[2];
+#endif
+  for (; i < n; i++) {
+    int32_t t = d[i & 3];
+    int32_t cr = GP_Clamp8((r + (t << 15)) >> 16);
+    int32_t cg = GP_Clamp8((g + (t << 14)) >> 16);
+    int32_t cb = GP_Clamp8((b + (t << 15)) >> 16);
+    p[i] = (uint16_t)(((cr >> 3) << 11) | ((cg >> 2) << 5) | (cb >> 3));
+    r += dc[0];
+    g += dc[1];
+    b += dc[2];
+  }
+}
+
+/*
+ * Walks the bound of a triangle edge a*x + b*y + c >= 0 over the rows: q is
+ * the first inside x (a > 0) or the last one (a < 0), kept with remainder r
+ * of divisor d, so a row step needs no division.
+ */
+typedef struct gp_edge_walk {
+  int64_t q, r, qs, rs, d;
+} GP_EDGE_WALK;
+
+static void GP_EdgeWalkInit(GP_EDGE_WALK *ew, int64_t a, int64_t b, int64_t c)
+{
+  int64_t m = a > 0 ? a - 1 - c : c;
+  int64_t step = a > 0 ? -b : b;
+
+  ew->d = a > 0 ? a : -a;
+  ew->q = GP_FloorDiv(m, ew->d);
+  ew->r = m - ew->q * ew->d;
+  ew->qs = GP_FloorDiv(step, ew->d);
+  ew->rs = step - ew->qs * ew->d;
+}
+
+static inline void GP_EdgeWalkStep(GP_EDGE_WALK *ew)
+{
+  ew->q += ew->qs;
+  ew->r += ew->rs;
+  if (ew->r >= ew->d) {
+    ew->r -= ew->d;
+    ew->q++;
+  }
+}
+
+void GP_FillShadedTriangle(const int16_t *x,
+                           const int16_t *y,
+                           const uint32_t *colors,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  int32_t px[3] = {x[0], x[1], x[2]}, py[3] = {y[0], y[1], y[2]};
+  int64_t area = (int64_t)(px[1] - px[0]) * (py[2] - py[0]) -
+                 (int64_t)(py[1] - py[0]) * (px[2] - px[0]);
+  int64_t s[3], gx[3], gy[3];
+  int32_t y1, y2;
+  int8_t dir = GP_IsRotated() ? -1 : 1;
+  GP_EDGE_WALK ew[3];
+  GP_TRI t;
+
+  if (!GP_TriSetup(&t, px, py))
+    return;
+  y1 = t.y1 > 0 ? t.y1 : 0;
+  y2 = t.y2 < (int32_t)h - 1 ? t.y2 : (int32_t)h - 1;
+
+  /*
+   * Channel planes: change per pixel gx, gy and s, sixteen times the value
+   * at x = 0 of the row, all Q16.
+   */
+  for (uint8_t k = 0; k < 3; k++) {
+    int64_t v0 = (colors[0] >> (16 - 8 * k)) & 0xFF;
+    int64_t v1 = ((colors[1] >> (16 - 8 * k)) & 0xFF) - v0;
+    int64_t v2 = ((colors[2] >> (16 - 8 * k)) & 0xFF) - v0;
+    gx[k] = (v1 * (py[2] - py[0]) - v2 * (py[1] - py[0])) * (16 << 16) / area;
+    gy[k] = (v2 * (px[1] - px[0]) - v1 * (px[2] - px[0])) * (16 << 16) / area;
+    /* Slivers thinner than 1/128 pixel are drawn flat. */
+    if (GP_Abs64(gx[k]) > INT32_MAX || GP_Abs64(gy[k]) > INT32_MAX)
+      gx[k] = gy[k] = 0;
+    s[k] = (v0 << 20) - gx[k] * px[0] + gy[k] * (16 * y1 - py[0]);
+    if (t.a[k] != 0)
+      GP_EdgeWalkInit(&ew[k], t.a[k], t.b[k], t.b[k] * y1 + t.c[k]);
+  }
+
+  for (int32_t row = y1; row <= y2; row++) {
+    int32_t l = t.x1 > 0 ? t.x1 : 0;
+    int32_t r = t.x2 < (int32_t)w - 1 ? t.x2 : (int32_t)w - 1;
+    int32_t c[3], dc[3], first;
+    uint8_t d[4];
+
+    for (uint8_t k = 0; k < 3; k++) {
+      if (t.a[k] > 0 && ew[k].q > l)
+        l = (int32_t)(ew[k].q < r + 1 ? ew[k].q : r + 1);
+      else if (t.a[k] < 0 && ew[k].q < r)
+        r = (int32_t)(ew[k].q > l - 1 ? ew[k].q : l - 1);
+      else if (t.a[k] == 0 && t.b[k] * row + t.c[k] < 0)
+        r = l - 1;
+      if (t.a[k] != 0)
+        GP_EdgeWalkStep(&ew[k]);
+    }
+
+    if (l <= r) {
+      /* Memory goes right to left in a rotated buffer. */
+      first = dir > 0 ? l : r;
+      for (uint8_t k = 0; k < 3; k++) {
+        int64_t g = dir * gx[k];
+        c[k] = (int32_t)((s[k] + 16 * gx[k] * first) >> 4);
+        /* Two pixels of a span differ by 255 at most. */
+        dc[k] = (int32_t)(g < -(256 << 16) ? -(256 << 16)
+                          : g > (256 << 16) ? (256 << 16)
+                                            : g);
+      }
+      for (uint8_t k = 0; k < 4; k++)
+        d[k] = GP_Bayer[row & 3][(first + dir * k) & 3];
+      GP_ShadeSpan(GP_PixelPtr(first, row, Buffer, w, h),
+                   (uint32_t)(r - l + 1), c, dc, d);
+    }
+    for (uint8_t k = 0; k < 3; k++)
+      s[k] += 16 * gy[k];
+  }
+}
+
+/**
+ *	Paths. Commands are flattened into the caller's point storage when they
+ *	are added. Filling accumulates the signed area of every edge into a cell
+ *	row per scanline (as in font-rs); a running sum over a row then gives the
+ *	coverage of each pixel. Cells left and right of the touched ones are not
+ *	visited, only full runs between edges are, as spans.
+ */
+
+#define GP_PATH_CELLS 4096 /* Accumulator cells, bands are used above it. */
+#define GP_PATH_ROWS 64    /* Max rows of a band. */
+
+static float GP_PathCells[GP_PATH_CELLS];
+static int32_t GP_PathTouched[GP_PATH_ROWS][2];
+
+static void GP_PathAdd(GP_PATH *path, int32_t x, int32_t y, uint8_t move)
+{
+  if (path->n == path->max) {
+    path->overflow = true;
+    return;
+  }
+  path->points[path->n].x = x;
+  path->points[path->n].y = y;
+  path->points[path->n].move = move;
+  path->n++;
+}
+
+/* Starts a new contour at the start of a closed one when needed. */
+static void GP_PathReopen(GP_PATH *path)
+{
+  if (path->closed) {
+    const GP_PATH_POINT *s = &path->points[path->start];
+    path->closed = false;
+    path->start = path->n;
+    GP_PathAdd(path, s->x, s->y, 1);
+  }
+}
+
+static void GP_PathSink(void *ctx, int32_t x, int32_t y)
+{
+  GP_PathAdd(ctx, x, y, 0);
+}
+
+void GP_PathInit(GP_PATH *path, GP_PATH_POINT *points, uint16_t max)
+{
+  path->points = points;
+  path->n = 0;
+  path->max = max;
+  path->start = 0;
+  path->closed = false;
+  path->overflow = false;
+}
+
+void GP_PathMoveTo(GP_PATH *path, int32_t x, int32_t y)
+{
+  path->closed = false;
+  path->start = path->n;
+  GP_PathAdd(path, x * 16, y * 16, 1);
+}
+
+void GP_PathLineTo(GP_PATH *path, int32_t x, int32_t y)
+{
+  GP_PathReopen(path);
+  if (path->n == 0)
+    GP_PathAdd(path, 0, 0, 1);
+  GP_PathAdd(path, x * 16, y * 16, 0);
+}
+
+void GP_PathQuadTo(GP_PATH *path, int32_t cx, int32_t cy, int32_t x, int32_t y)
+{
+  int32_t px[3], py[3];
+
+  GP_PathReopen(path);
+  if (path->n == 0)
+    GP_PathAdd(path, 0, 0, 1);
+  px[0] = path->points[path->n - 1].x;
+  py[0] = path->points[path->n - 1].y;
+  px[1] = cx * 16;
+  py[1] = cy * 16;
+  px[2] = x * 16;
+  py[2] = y * 16;
+  GP_FlattenQuad(px, py, GP_PathSink, path);
+}
+
+void GP_PathCubicTo(GP_PATH *path,
+                    int32_t cx1,
+                    int32_t cy1,
+                    int32_t cx2,
+                    int32_t cy2,
+                    int32_t x,
+                    int32_t y)
+{
+  int32_t px[4], py[4];
+
+  GP_PathReopen(path);
+  if (path->n == 0)
+    GP_PathAdd(path, 0, 0, 1);
+  px[0] = path->points[path->n - 1].x;
+  py[0] = path->points[path->n - 1].y;
+  px[1] = cx1 * 16;
+  py[1] = cy1 * 16;
+  px[2] = cx2 * 16;
+  py[2] = cy2 * 16;
+  px[3] = x * 16;
+  py[3] = y * 16;
+  GP_FlattenCubic(px, py, GP_PathSink, path);
+}
+
+void GP_PathClose(GP_PATH *path)
+{
+  const GP_PATH_POINT *s, *e;
+
+  if (path->n == 0 || path->closed)
+    return;
+  s = &path->points[path->start];
+  e = &path->points[path->n - 1];
+  if (e->x != s->x || e->y != s->y)
+    GP_PathAdd(path, s->x, s->y, 0);
+  path->closed = true;
+}
+
+/*
+ * Adds the edge x0, y0 - x1, y1 (pixels, relative to the band) to the cells
+ * of rows 0..rows - 1. The edge must lie in columns 0..stride - 2.
+ */
+static void GP_PathCell(int32_t stride,
+                        int32_t rows,
+                        float x0,
+                        float y0,
+                        float x1,
+                        float y1)
+{
+  float dir = 1.0f, dxdy, x;
+
+  if (y0 == y1)
+    return;
+  if (y0 > y1) {
+    float t = x0;
+    x0 = x1;
+    x1 = t;
+    t = y0;
+    y0 = y1;
+    y1 = t;
+    dir = -1.0f;
+  }
+  if (y1 <= 0.0f || y0 >= (float)rows)
+    return;
+  dxdy = (x1 - x0) / (y1 - y0);
+  x = x0;
+  if (y0 < 0.0f) {
+    x -= y0 * dxdy;
+    y0 = 0.0f;
+  }
+  if (y1 > (float)rows)
+    y1 = (float)rows;
+
+  for (int32_t y = (int32_t)y0; (float)y < y1; y++) {
+    float *a = GP_PathCells + y * stride;
+    float dy = ((float)(y + 1) < y1 ? (float)(y + 1) : y1) -
+               ((float)y > y0 ? (float)y : y0);
+    float xnext = x + dxdy * dy, d = dy * dir;
+    float xa = x < xnext ? x : xnext, xb = x < xnext ? xnext : x;
+    int32_t ia = (int32_t)xa, ib = (int32_t)xb + ((float)(int32_t)xb < xb);
+    float xaf = (float)ia;
+
+    if (ia < GP_PathTouched[y][0])
+      GP_PathTouched[y][0] = ia;
+    if (ib + 1 > GP_PathTouched[y][1])
+      GP_PathTouched[y][1] = ib + 1;
+
+    if (ib <= ia + 1) {
+      float xmf = 0.5f * (x + xnext) - xaf;
+      a[ia] += d - d * xmf;
+      a[ia + 1] += d * xmf;
+    } else {
+      float s = 1.0f / (xb - xa);
+      float x0f = xa - xaf;
+      float a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+      float x1f = xb - (float)ib + 1.0f;
+      float am = 0.5f * s * x1f * x1f;
+
+      a[ia] += d * a0;
+      if (ib == ia + 2) {
+        a[ia + 1] += d * (1.0f - a0 - am);
+      } else {
+        float a1 = s * (1.5f - x0f);
+        a[ia + 1] += d * (a1 - a0);
+        for (int32_t i = ia + 2; i < ib - 1; i++)
+          a[i] += d * s;
+        a[ib - 1] += d * (1.0f - a1 - (float)(ib - ia - 3) * s - am);
+      }
+      a[ib] += d * am;
+    }
+    x = xnext;
+  }
+}
+
+/* Splits an edge at the band sides, the parts outside run along them. */
+static void GP_PathEdge(int32_t stride,
+                        int32_t rows,
+                        float x0,
+                        float y0,
+                        float x1,
+                        float y1)
+{
+  float right = (float)(stride - 2);
+
+  for (int side = 0; side < 2; side++) {
+    float b = side ? right : 0.0f;
+    if ((x0 - b) * (x1 - b) < 0.0f) {
+      float yb = y0 + (y1 - y0) * (b - x0) / (x1 - x0);
+      GP_PathEdge(stride, rows, x0, y0, b, yb);
+      GP_PathEdge(stride, rows, b, yb, x1, y1);
+      return;
+    }
+  }
+  x0 = x0 < 0.0f ? 0.0f : x0 > right ? right : x0;
+  x1 = x1 < 0.0f ? 0.0f : x1 > right ? right : x1;
+  GP_PathCell(stride, rows, x0, y0, x1, y1);
+}
+
+/* Coverage of a running sum of cells. */
+static inline uint8_t GP_PathAlpha(float acc, uint8_t rule)
+{
+  float c = acc < 0.0f ? -acc : acc;
+
+  if (rule == GP_FILL_EVEN_ODD) {
+    c -= 2.0f * (float)(int32_t)(c * 0.5f);
+    if (c > 1.0f)
+      c = 2.0f - c;
+  } else if (c > 1.0f) {
+    c = 1.0f;
+  }
+  return (uint8_t)(c * 255.0f + 0.5f);
+}
+
+/* Blends row y of the band from its cells and clears them. */
+static void GP_PathRow(int32_t x0,
+                       int32_t y,
+                       float *a,
+                       int32_t lo,
+                       int32_t hi,
+                       int32_t width,
+                       uint8_t rule,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  float acc = 0.0f;
+  int32_t run = -1;
+  uint8_t c = 0;
+
+  if (lo < 0)
+    lo = 0;
+  if (hi > width)
+    hi = width;
+  for (int32_t i = lo; i < width; i++) {
+    /* Past the last touched cell the coverage stays the same. */
+    if (i >= hi) {
+      if (c == 255 && run < 0)
+        run = i;
+      else if (c != 0 && c != 255)
+        for (; i < width; i++)
+          GP_BlendPixel(x0 + i, y, color, c, Buffer, w, h);
+      break;
+    }
+    acc += a[i];
+    a[i] = 0.0f;
+    c = GP_PathAlpha(acc, rule);
+    if (c == 255) {
+      if (run < 0)
+        run = i;
+      continue;
+    }
+    if (run >= 0) {
+      GP_SetSpanH(x0 + run, x0 + i - 1, y, color, Buffer, w, h);
+      run = -1;
+    }
+    if (c != 0)
+      GP_BlendPixel(x0 + i, y, color, c, Buffer, w, h);
+  }
+  if (run >= 0)
+    GP_SetSpanH(x0 + run, x0 + width - 1, y, color, Buffer, w, h);
+  a[width] = a[width + 1] = 0.0f;
+}
+
+void GP_FillPath(const GP_PATH *path,
+                 uint8_t rule,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h)
+{
+  int32_t xmin = INT32_MAX, xmax = INT32_MIN;
+  int32_t ymin = INT32_MAX, ymax = INT32_MIN;
+  int32_t x0, x1, y0, y1, width, stride, band;
+  const float scale = 1.0f / GP_FIX_ONE;
+
+  for (uint16_t i = 0; i < path->n; i++) {
+    const GP_PATH_POINT *p = &path->points[i];
+    if (p->x < xmin)
+      xmin = p->x;
+    if (p->x > xmax)
+      xmax = p->x;
+    if (p->y < ymin)
+      ymin = p->y;
+    if (p->y > ymax)
+      ymax = p->y;
+  }
+  if (path->n < 2)
+    return;
+
+  /* Pixels touched by the path, clipped to the buffer. */
+  x0 = (xmin + GP_FIX_HALF) >> GP_FIX_SHIFT;
+  x1 = ((xmax + GP_FIX_HALF) >> GP_FIX_SHIFT) + 1;
+  y0 = (ymin + GP_FIX_HALF) >> GP_FIX_SHIFT;
+  y1 = ((ymax + GP_FIX_HALF) >> GP_FIX_SHIFT) + 1;
+  if (x0 < 0)
+    x0 = 0;
+  if (y0 < 0)
+    y0 = 0;
+  if (x1 > (int32_t)w)
+    x1 = (int32_t)w;
+  if (y1 > (int32_t)h)
+    y1 = (int32_t)h;
+  width = x1 - x0;
+  stride = width + 2;
+  if (width <= 0 || y1 <= y0 || stride > GP_PATH_CELLS)
+    return;
+  band = GP_PATH_CELLS / stride;
+  if (band > GP_PATH_ROWS)
+    band = GP_PATH_ROWS;
+
+  for (int32_t top = y0; top < y1; top += band) {
+    int32_t rows = y1 - top < band ? y1 - top : band;
+    int32_t ox = (x0 << GP_FIX_SHIFT) - GP_FIX_HALF;
+    int32_t oy = (top << GP_FIX_SHIFT) - GP_FIX_HALF;
+    uint16_t first = 0;
+
+    for (int32_t r = 0; r < rows; r++) {
+      GP_PathTouched[r][0] = stride;
+      GP_PathTouched[r][1] = 0;
+    }
+
+    /*
+     * Every contour is closed by an edge back to its first point. Cell i
+     * is the pixel x0 + i, centered at x0 + i + 0.5 of the band.
+     */
+    for (uint16_t i = 0; i < path->n; i++) {
+      const GP_PATH_POINT *p = &path->points[i], *q;
+      if (p->move)
+        first = i;
+      q = i + 1 < path->n && !path->points[i + 1].move ? p + 1
+                                                       : &path->points[first];
+      GP_PathEdge(stride, rows, (float)(p->x - ox) * scale,
+                  (float)(p->y - oy) * scale, (float)(q->x - ox) * scale,
+                  (float)(q->y - oy) * scale);
+    }
+
+    for (int32_t r = 0; r < rows; r++)
+      GP_PathRow(x0, top + r, GP_PathCells + r * stride, GP_PathTouched[r][0],
+                 GP_PathTouched[r][1], width, rule, color, Buffer, w, h);
+  }
+}
+
+/**
+ *	Signed distance shapes. The distance to the shape is evaluated for eight
+ *	pixels of a row at once, in SSE2 lanes where there are, and 0.5 - d gives
+ *	the coverage. A distance field changes by one pixel per pixel at most, so
+ *	one sample at the center of an 8x8 tile tells whether the whole tile is
+ *	outside (skipped) or inside (filled by spans) of the shape.
+ */
+
+#define GP_SDF_TILE 8
+#define GP_SDF_MARGIN 5.5f /* Center to corner pixel of a tile, and 0.5. */
+#define GP_SDF_UNIT (1.0f / 16.0f) /* 1/16 pixel of the public functions. */
+
+#define GP_SDF_BOX 0 /* Rounded box, a circle when both half sizes are zero. */
+#define GP_SDF_CAPSULE 1
+
+typedef struct gp_sdf
+{
+  float ax, ay; /* Center, or the first end of a capsule. */
+  float bx, by; /* Half sizes of the box less the radius, or the second end. */
+  float r;
+  uint8_t kind;
+} GP_SDF;
+
+/* Distances of the pixels x..x + GP_SDF_TILE - 1 of row y. */
+static void GP_SdfRow(const GP_SDF *s, float x, float y, float *d)
+{
+  float bax = s->bx - s->ax, bay = s->by - s->ay;
+  float l = bax * bax + bay * bay;
+  float k = l > 0.0f ? 1.0f / l : 0.0f;
+#if defined(__SSE2__)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 step = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  const __m128 r = _mm_set1_ps(s->r);
+  const __m128 ax = _mm_set1_ps(s->ax);
+
+  if (s->kind == GP_SDF_BOX) {
+    float qy = (y < s->ay ? s->ay - y : y - s->ay) - s->by;
+    __m128 vqy = _mm_set1_ps(qy);
+    __m128 oy = _mm_set1_ps(qy > 0.0f ? qy * qy : 0.0f);
+    __m128 bx = _mm_set1_ps(s->bx);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (uint32_t i = 0; i < GP_SDF_TILE; i += 4) {
+      __m128 px = _mm_add_ps(_mm_set1_ps(x + (float)i), step);
+      __m128 qx = _mm_sub_ps(_mm_andnot_ps(sign, _mm_sub_ps(px, ax)), bx);
+      __m128 ox = _mm_max_ps(qx, zero);
+      __m128 in = _mm_min_ps(_mm_max_ps(qx, vqy), zero);
+      __m128 v = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ox, ox), oy));
+      _mm_storeu_ps(d + i, _mm_sub_ps(_mm_add_ps(v, in), r));
+    }
+  } else {
+    __m128 vbx = _mm_set1_ps(bax), vby = _mm_set1_ps(bay);
+    __m128 pay = _mm_set1_ps(y - s->ay);
+    __m128 ty = _mm_mul_ps(pay, vby);
+    __m128 vk = _mm_set1_ps(k), one = _mm_set1_ps(1.0f);
+    for (uint32_t i = 0; i < GP_SDF_TILE; i += 4) {
+      __m128 pax = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(x + (float)i), step), ax);
+      __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(pax, vbx), ty), vk);
+      __m128 dx, dy;
+      t = _mm_min_ps(_mm_max_ps(t, zero), one);
+      dx = _mm_sub_ps(pax, _mm_mul_ps(vbx, t));
+      dy = _mm_sub_ps(pay, _mm_mul_ps(vby, t));
+      dx = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+      _mm_storeu_ps(d + i, _mm_sub_ps(dx, r));
+    }
+  }
+#else
+  float e[GP_SDF_TILE];
+
+  if (s->kind == GP_SDF_BOX) {
+    float qy = (y < s->ay ? s->ay - y : y - s->ay) - s->by;
+    float oy = qy > 0.0f ? qy * qy : 0.0f;
+    for (uint32_t i = 0; i < GP_SDF_TILE; i++) {
+      float px = x + (float)i;
+      float qx = (px < s->ax ? s->ax - px : px - s->ax) - s->bx;
+      float m = qx > qy ? qx : qy;
+      d[i] = (qx > 0.0f ? qx * qx : 0.0f) + oy;
+      e[i] = (m < 0.0f ? m : 0.0f) - s->r;
+    }
+  } else {
+    float pay = y - s->ay;
+    for (uint32_t i = 0; i < GP_SDF_TILE; i++) {
+      float pax = x + (float)i - s->ax;
+      float t = (pax * bax + pay * bay) * k;
+      float dx, dy;
+      t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+      dx = pax - bax * t;
+      dy = pay - bay * t;
+      d[i] = dx * dx + dy * dy;
+      e[i] = -s->r;
+    }
+  }
+  /* Two Newton steps from the halved exponent, without libm. */
+  for (uint32_t i = 0; i < GP_SDF_TILE; i++) {
+    union {
+      float f;
+      uint32_t u;
+    } g = {d[i]};
+    g.u = 0x1FBD1DF5 + (g.u >> 1);
+    g.f = 0.5f * (g.f + d[i] / g.f);
+    d[i] = 0.5f * (g.f + d[i] / g.f) + e[i];
+  }
+#endif
+}
+
+/* Blends n pixels of row y from their distances, full runs as spans. */
+static void GP_SdfSpan(int32_t x,
+                       int32_t y,
+                       const float *d,
+                       int32_t n,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  uint8_t a[GP_SDF_TILE];
+  int32_t run = -1;
+
+  for (int32_t i = 0; i < GP_SDF_TILE; i++) {
+    float c = (0.5f - d[i]) * 255.0f + 0.5f;
+    a[i] = (uint8_t)(c < 0.0f ? 0.0f : c > 255.0f ? 255.0f : c);
+  }
+  for (int32_t i = 0; i < n; i++) {
+    if (a[i] == 255) {
+      if (run < 0)
+        run = i;
+      continue;
+    }
+    if (run >= 0) {
+      GP_SetSpanH(x + run, x + i - 1, y, color, Buffer, w, h);
+      run = -1;
+    }
+    GP_BlendPixel(x + i, y, color, a[i], Buffer, w, h);
+  }
+  if (run >= 0)
+    GP_SetSpanH(x + run, x + n - 1, y, color, Buffer, w, h);
+}
+
+/* Fills a shape within the bounds x0..x1 by y0..y1, clipped to the buffer. */
+static void GP_FillSdf(const GP_SDF *s,
+                       float x0,
+                       float y0,
+                       float x1,
+                       float y1,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  float d[GP_SDF_TILE];
+  int32_t l, t, r, b;
+
+  /* Pixels within half a pixel of the bounds, kept in the int range. */
+  x0 = x0 < -1.0f ? -1.0f : x0 > (float)w ? (float)w : x0;
+  y0 = y0 < -1.0f ? -1.0f : y0 > (float)h ? (float)h : y0;
+  x1 = x1 < -1.0f ? -1.0f : x1 > (float)w ? (float)w : x1;
+  y1 = y1 < -1.0f ? -1.0f : y1 > (float)h ? (float)h : y1;
+  l = (int32_t)(x0 + 1.0f) - 2;
+  t = (int32_t)(y0 + 1.0f) - 2;
+  r = (int32_t)(x1 + 1.0f);
+  b = (int32_t)(y1 + 1.0f);
+  if (l < 0)
+    l = 0;
+  if (t < 0)
+    t = 0;
+  if (r > (int32_t)w - 1)
+    r = (int32_t)w - 1;
+  if (b > (int32_t)h - 1)
+    b = (int32_t)h - 1;
+  if (r < l || b < t)
+    return;
+
+  for (int32_t ty = t; ty <= b; ty += GP_SDF_TILE) {
+    int32_t rows = b - ty + 1 < GP_SDF_TILE ? b - ty + 1 : GP_SDF_TILE;
+    int32_t run = -1;
+
+    for (int32_t tx = l; tx <= r; tx += GP_SDF_TILE) {
+      int32_t n = r - tx + 1 < GP_SDF_TILE ? r - tx + 1 : GP_SDF_TILE;
+
+      /* The first distance of a row at the tile center. */
+      GP_SdfRow(s, (float)tx + 3.5f, (float)ty + 3.5f, d);
+      if (d[0] <= -GP_SDF_MARGIN) {
+        /* Inside tiles of a row are filled together. */
+        if (run < 0)
+          run = tx;
+        continue;
+      }
+      if (run >= 0) {
+        for (int32_t i = 0; i < rows; i++)
+          GP_SetSpanH(run, tx - 1, ty + i, color, Buffer, w, h);
+        run = -1;
+      }
+      if (d[0] >= GP_SDF_MARGIN)
+        continue;
+      for (int32_t i = 0; i < rows; i++) {
+        GP_SdfRow(s, (float)tx, (float)(ty + i), d);
+        GP_SdfSpan(tx, ty + i, d, n, color, Buffer, w, h);
+      }
+    }
+    if (run >= 0)
+      for (int32_t i = 0; i < rows; i++)
+        GP_SetSpanH(run, r, ty + i, color, Buffer, w, h);
+  }
+}
+
+void GP_FillRoundedRectSDF(int32_t x,
+                           int32_t y,
+                           int32_t width,
+                           int32_t heigth,
+                           int32_t r,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  GP_SDF s;
+  float hw = (float)width * (0.5f * GP_SDF_UNIT);
+  float hh = (float)heigth * (0.5f * GP_SDF_UNIT);
+
+  if (width < 0 || heigth < 0 || r < 0)
+    return;
+  s.kind = GP_SDF_BOX;
+  s.ax = (float)x * GP_SDF_UNIT;
+  s.ay = (float)y * GP_SDF_UNIT;
+  s.r = (float)r * GP_SDF_UNIT;
+  if (s.r > hw)
+    s.r = hw;
+  if (s.r > hh)
+    s.r = hh;
+  s.bx = hw - s.r;
+  s.by = hh - s.r;
+  GP_FillSdf(&s, s.ax - hw, s.ay - hh, s.ax + hw, s.ay + hh, color, Buffer, w,
+             h);
+}
+
+void GP_FillCircleSDF(int32_t x,
+                      int32_t y,
+                      int32_t r,
+                      uint16_t color,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h)
+{
+  GP_FillRoundedRectSDF(x, y, 2 * r, 2 * r, r, color, Buffer, w, h);
+}
+
+void GP_FillCapsuleSDF(int32_t x1,
+                       int32_t y1,
+                       int32_t x2,
+                       int32_t y2,
+                       int32_t r,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  GP_SDF s;
+
+  if (r < 0)
+    return;
+  s.kind = GP_SDF_CAPSULE;
+  s.ax = (float)x1 * GP_SDF_UNIT;
+  s.ay = (float)y1 * GP_SDF_UNIT;
+  s.bx = (float)x2 * GP_SDF_UNIT;
+  s.by = (float)y2 * GP_SDF_UNIT;
+  s.r = (float)r * GP_SDF_UNIT;
+  GP_FillSdf(&s, (s.ax < s.bx ? s.ax : s.bx) - s.r,
+             (s.ay < s.by ? s.ay : s.by) - s.r,
+             (s.ax > s.bx ? s.ax : s.bx) + s.r,
+             (s.ay > s.by ? s.ay : s.by) + s.r, color, Buffer, w, h);
+}
+
+/* Vertices of GP_PutTriangle, the apex first. */
+static bool GP_TriangleVertices(uint16_t x,
+                                uint16_t y,
+                                uint16_t width,
+                                uint16_t heigth,
+                                uint8_t side,
+                                uint16_t *px,
+                                uint16_t *py)
+{
+  switch (side) {
+  case GP_NORTH:
+    px[0] = x;
+    py[0] = y - heigth / 2;
+    px[1] = x - width / 2;
+    py[1] = y + heigth / 2;
+    px[2] = x + width / 2;
+    py[2] = y + heigth / 2;
+    break;
+  case GP_SOUTH:
+    px[0] = x;
+    py[0] = y + heigth / 2;
+    px[1] = x - width / 2;
+    py[1] = y - heigth / 2;
+    px[2] = x + width / 2;
+    py[2] = y - heigth / 2;
+    break;
+  case GP_WEST:
+    px[0] = x - width / 2;
+    py[0] = y;
+    px[1] = x + width / 2;
+    py[1] = y - heigth / 2;
+    px[2] = x + width / 2;
+    py[2] = y + heigth / 2;
+    break;
+  case GP_EAST:
+    px[0] = x + width / 2;
+    py[0] = y;
+    px[1] = x - width / 2;
+    py[1] = y + heigth / 2;
+    px[2] = x - width / 2;
+    py[2] = y - heigth / 2;
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+void GP_PutTriangle(uint16_t x,
+                    uint16_t y,
+                    uint16_t width,
+                    uint16_t heigth,
+                    uint8_t side,
+                    uint16_t color,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h)
+{
+  uint16_t px[3], py[3];
+
+  if (!GP_TriangleVertices(x, y, width, heigth, side, px, py))
+    return;
+  GP_SetBresenhamLine(px[0], py[0], px[1], py[1], color, Buffer, w, h);
+  GP_SetBresenhamLine(px[1], py[1], px[2], py[2], color, Buffer, w, h);
+  GP_SetBresenhamLine(px[2], py[2], px[0], py[0], color, Buffer, w, h);
+}
+
+void GP_PutFilledTriangle(uint16_t x,
+                          uint16_t y,
+                          uint16_t width,
+                          uint16_t heigth,
+                          uint8_t side,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h)
+{
+  uint16_t px[3], py[3];
+
+  if (!GP_TriangleVertices(x, y, width, heigth, side, px, py))
+    return;
+  GP_FillPolygon(px, py, 3, GP_FILL_NON_ZERO, color, Buffer, w, h);
+  GP_PutTriangle(x, y, width, heigth, side, color, Buffer, w, h);
+}
+
+/*
+ * Vertices of GP_PutArrow going around the outline: the point, a barb, the
+ * shaft corners and the other barb.
+ */
+static bool GP_ArrowVertices(uint16_t x,
+                             uint16_t y,
+                             uint16_t width,
+                             uint16_t heigth,
+                             uint8_t side,
+                             uint16_t *px,
+                             uint16_t *py)
+{
+  uint16_t l_w, l_h;
+
+  switch (side) {
+  case GP_NORTH:
+    l_w = heigth;
+    l_h = width;
+    px[0] = x;
+    py[0] = y - l_h / 2;
+    px[1] = x - l_w / 2;
+    py[1] = y - l_h / 6;
+    px[6] = x + l_w / 2;
+    py[6] = y - l_h / 6;
+
+    px[2] = x - l_w / 4;
+    py[2] = y - l_h / 6;
+    px[5] = x + l_w / 4;
+    py[5] = py[2];
+    px[3] = px[2];
+    py[3] = y + l_h / 2;
+    px[4] = px[5];
+    py[4] = py[3];
+    break;
+  case GP_SOUTH:
     l_w = heigth;
     l_h = width;
-    x0 = x;
-    y0 = y - l_h / 2;
-    x1_1 = x - l_w / 2;
-    y1_1 = y - l_h / 6;
-    x1_2 = x + l_w / 2;
-    y1_2 = y - l_h / 6;
-
-    x1 = x - l_w / 4;
-    y1 = y - l_h / 6;
-    x2 = x + l_w / 4;
-    y2 = y1;
-    x3 = x1;
-    y3 = y + l_h / 2;
-    x4 = x2;
-    y4 = y3;
+    px[0] = x;
+    py[0] = y + l_h / 2;
+    px[1] = x + l_w / 2;
+    py[1] = y + l_h / 6;
+    px[6] = x - l_w / 2;
+    py[6] = y + l_h / 6;
+
+    px[2] = x + l_w / 4;
+    py[2] = y + l_h / 6;
+    px[5] = x - l_w / 4;
+    py[5] = py[2];
+    px[3] = px[2];
+    py[3] = y - l_h / 2;
+    px[4] = px[5];
+    py[4] = py[3];
+    break;
+  case GP_WEST:
+    l_w = width;
+    l_h = heigth;
+    px[0] = x - l_w / 2;
+    py[0] = y;
+    px[1] = x - l_w / 6;
+    py[1] = y + l_h / 2;
+    px[6] = x - l_w / 6;
+    py[6] = y - l_h / 2;
+
+    px[2] = x - l_w / 6;
+    py[2] = y + l_h / 4;
+    px[5] = px[2];
+    py[5] = y - l_h / 4;
+    px[3] = x + l_w / 2;
+    py[3] = py[2];
+    px[4] = px[3];
+    py[4] = py[5];
+    break;
+  case GP_EAST:
+    l_w = width;
+    l_h = heigth;
+    px[0] = x + l_w / 2;
+    py[0] = y;
+    px[1] = x + l_w / 6;
+    py[1] = y - l_h / 2;
+    px[6] = x + l_w / 6;
+    py[6] = y + l_h / 2;
+
+    px[2] = x + l_w / 6;
+    py[2] = y - l_h / 4;
+    px[5] = px[2];
+    py[5] = y + l_h / 4;
+    px[3] = x - l_w / 2;
+    py[3] = py[2];
+    px[4] = px[3];
+    py[4] = py[5];
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+void GP_PutArrow(uint16_t x,
+                 uint16_t y,
+                 uint16_t width,
+                 uint16_t heigth,
+                 uint8_t side,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h)
+{
+  uint16_t px[7], py[7];
+
+  if (!GP_ArrowVertices(x, y, width, heigth, side, px, py))
+    return;
+  GP_SetBresenhamLine(px[0], py[0], px[1], py[1], color, Buffer, w, h);
+  GP_SetBresenhamLine(px[0], py[0], px[6], py[6], color, Buffer, w, h);
+
+  GP_SetBresenhamLine(px[1], py[1], px[2], py[2], color, Buffer, w, h);
+  GP_SetBresenhamLine(px[5], py[5], px[6], py[6], color, Buffer, w, h);
+
+  GP_SetBresenhamLine(px[2], py[2], px[3], py[3], color, Buffer, w, h);
+  GP_SetBresenhamLine(px[5], py[5], px[4], py[4], color, Buffer, w, h);
+
+  GP_SetBresenhamLine(px[3], py[3], px[4], py[4], color, Buffer, w, h);
+}
+
+void GP_PutFilledArrow(uint16_t x,
+                       uint16_t y,
+                       uint16_t width,
+                       uint16_t heigth,
+                       uint8_t side,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h)
+{
+  uint16_t px[7], py[7];
+
+  if (!GP_ArrowVertices(x, y, width, heigth, side, px, py))
+    return;
+  GP_FillPolygon(px, py, 7, GP_FILL_NON_ZERO, color, Buffer, w, h);
+  GP_PutArrow(x, y, width, heigth, side, color, Buffer, w, h);
+}
+
+/**
+ *	Caches. An entry of a cache keeps data of any size in the pool of the
+ *	cache. When new data does not fit, the least recently used entries are
+ *	dropped and the pool is compacted.
+ */
+
+typedef struct gp_cache_entry
+{
+  uint32_t offset; /* In the pool. */
+  uint32_t bytes;
+  uint32_t stamp; /* Last use. */
+  bool used;
+} GP_CACHE_ENTRY;
+
+typedef struct gp_cache
+{
+  uint8_t *pool;
+  uint32_t size, top;
+  GP_CACHE_ENTRY *e;
+  uint32_t n;
+  uint32_t clock, hits, misses;
+} GP_CACHE;
+
+/* A free entry, or the least recently used one. */
+static uint32_t GP_CacheVictim(const GP_CACHE *c)
+{
+  uint32_t k = 0;
+
+  for (uint32_t i = 0; i < c->n; i++) {
+    if (!c->e[i].used)
+      return i;
+    if (c->e[i].stamp < c->e[k].stamp)
+      k = i;
+  }
+  return k;
+}
+
+/* Gives entry k bytes of the pool. The entry is used once its data is in. */
+static bool GP_CacheAlloc(GP_CACHE *c, uint32_t k, uint32_t bytes)
+{
+  uint32_t free = c->size;
+
+  c->e[k].used = false;
+  if (bytes > c->size)
+    return false;
+  for (uint32_t i = 0; i < c->n; i++)
+    if (c->e[i].used)
+      free -= c->e[i].bytes;
+  while (free < bytes) {
+    GP_CACHE_ENTRY *lru = NULL;
+    for (uint32_t i = 0; i < c->n; i++)
+      if (c->e[i].used && (!lru || c->e[i].stamp < lru->stamp))
+        lru = &c->e[i];
+    lru->used = false;
+    free += lru->bytes;
+  }
+
+  if (c->top + bytes > c->size) {
+    /* Moves the data down in pool order. */
+    c->top = 0;
+    for (;;) {
+      GP_CACHE_ENTRY *next = NULL;
+      for (uint32_t i = 0; i < c->n; i++)
+        if (c->e[i].used && c->e[i].offset >= c->top &&
+            (!next || c->e[i].offset < next->offset))
+          next = &c->e[i];
+      if (!next)
+        break;
+      memmove(c->pool + c->top, c->pool + next->offset, next->bytes);
+      next->offset = c->top;
+      c->top += next->bytes;
+    }
+  }
+  c->e[k].offset = c->top;
+  c->e[k].bytes = bytes;
+  c->e[k].stamp = c->clock;
+  c->top += bytes;
+  return true;
+}
+
+static void GP_CacheReset(GP_CACHE *c)
+{
+  memset(c->e, 0, sizeof(GP_CACHE_ENTRY) * c->n);
+  c->top = 0;
+  c->hits = 0;
+  c->misses = 0;
+}
+
+/**
+ *	Shape cache. A shape is drawn once into a scratch buffer, white on
+ *	black, and kept as a mask: 1 bit per pixel, or the 5 bit alpha of
+ *	GP_Blend565 in a byte for anti-aliased shapes.
+ */
+
+#ifndef GP_SHAPE_CACHE_BYTES
+#define GP_SHAPE_CACHE_BYTES 8192 /**< Memory of the cached masks. */
+#endif
+#define GP_SHAPE_CACHE_SLOTS 32   /**< Max cached masks. */
+#define GP_SHAPE_MAX 64           /**< Max side of a cached mask. */
+
+typedef struct gp_shape_key
+{
+  uint16_t width, heigth;
+  uint8_t shape, side;
+  bool aa;
+  int16_t hx, hy; /* Center of the mask. */
+} GP_SHAPE_KEY;
+
+static uint8_t GP_ShapePool[GP_SHAPE_CACHE_BYTES];
+static uint16_t GP_ShapeScratch[GP_SHAPE_MAX * GP_SHAPE_MAX];
+static GP_SHAPE_KEY GP_ShapeKeys[GP_SHAPE_CACHE_SLOTS];
+static GP_CACHE_ENTRY GP_ShapeEntries[GP_SHAPE_CACHE_SLOTS];
+static GP_CACHE GP_ShapeCache = {GP_ShapePool, GP_SHAPE_CACHE_BYTES, 0,
+                                 GP_ShapeEntries, GP_SHAPE_CACHE_SLOTS,
+                                 0, 0, 0};
+
+/* Draws a shape around x, y. False for an unknown shape or side. */
+static bool GP_ShapeDraw(uint8_t shape,
+                         int32_t x,
+                         int32_t y,
+                         uint16_t width,
+                         uint16_t heigth,
+                         uint8_t side,
+                         bool aa,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  GP_PATH_POINT pt[7];
+  GP_PATH path;
+  uint16_t px[7], py[7];
+  uint8_t n;
+
+  switch (shape) {
+  case GP_SHAPE_ARROW:
+  case GP_SHAPE_TRIANGLE:
+  case GP_SHAPE_FILLED_ARROW:
+  case GP_SHAPE_FILLED_TRIANGLE:
+    if (side < GP_NORTH || side > GP_EAST)
+      return false;
+    break;
+  case GP_SHAPE_CROSS:
+    GP_SetCross(x, y, width, color, Buffer, w, h);
+    return true;
+  case GP_SHAPE_CIRCLE:
+    if (aa)
+      GP_DrawRingAA(x, y, width, width, color, Buffer, w, h);
+    else
+      GP_SetBresenhamCircle(x, y, width, color, Buffer, w, h);
+    return true;
+  case GP_SHAPE_FILLED_CIRCLE:
+    if (aa)
+      GP_DrawFilledCircleAA(x, y, width, color, Buffer, w, h);
+    else
+      GP_DrawFilledCircle(x, y, width, color, Buffer, w, h);
+    return true;
+  default:
+    return false;
+  }
+
+  if (shape == GP_SHAPE_ARROW)
+    GP_PutArrow(x, y, width, heigth, side, color, Buffer, w, h);
+  else if (shape == GP_SHAPE_TRIANGLE)
+    GP_PutTriangle(x, y, width, heigth, side, color, Buffer, w, h);
+  else if (!aa && shape == GP_SHAPE_FILLED_ARROW)
+    GP_PutFilledArrow(x, y, width, heigth, side, color, Buffer, w, h);
+  else if (!aa)
+    GP_PutFilledTriangle(x, y, width, heigth, side, color, Buffer, w, h);
+  if (!aa || shape == GP_SHAPE_ARROW || shape == GP_SHAPE_TRIANGLE)
+    return true;
+
+  /* Anti-aliased fills go through a path of the same vertices. */
+  if (shape == GP_SHAPE_FILLED_ARROW) {
+    GP_ArrowVertices(x, y, width, heigth, side, px, py);
+    n = 7;
+  } else {
+    GP_TriangleVertices(x, y, width, heigth, side, px, py);
+    n = 3;
+  }
+  GP_PathInit(&path, pt, 7);
+  GP_PathMoveTo(&path, px[0] * 16, py[0] * 16);
+  for (uint8_t i = 1; i < n; i++)
+    GP_PathLineTo(&path, px[i] * 16, py[i] * 16);
+  GP_FillPath(&path, GP_FILL_NON_ZERO, color, Buffer, w, h);
+  return true;
+}
+
+/* Half sizes of the mask of a shape, anti-aliased edges included. */
+static void GP_ShapeExtent(uint8_t shape,
+                           uint16_t width,
+                           uint16_t heigth,
+                           uint8_t side,
+                           int32_t *hx,
+                           int32_t *hy)
+{
+  bool turned = (shape == GP_SHAPE_ARROW || shape == GP_SHAPE_FILLED_ARROW) &&
+                (side == GP_NORTH || side == GP_SOUTH);
+
+  switch (shape) {
+  case GP_SHAPE_CROSS:
+    *hx = *hy = (width / 2 > 20 ? width / 2 : 20) + 1;
+    break;
+  case GP_SHAPE_CIRCLE:
+  case GP_SHAPE_FILLED_CIRCLE:
+    *hx = *hy = width + 2;
+    break;
+  default:
+    *hx = (turned ? heigth : width) / 2 + 1;
+    *hy = (turned ? width : heigth) / 2 + 1;
+    break;
+  }
+}
+
+/* Draws a shape into the scratch buffer and keeps its mask in entry k. */
+static bool GP_ShapeRaster(uint32_t k)
+{
+  const GP_SHAPE_KEY *s = &GP_ShapeKeys[k];
+  int32_t mw = 2 * s->hx + 1, mh = 2 * s->hy + 1;
+  uint32_t stride = s->aa ? (uint32_t)mw : (uint32_t)(mw + 7) / 8;
+  uint8_t *m;
+
+  memset(GP_ShapeScratch, 0, sizeof(uint16_t) * mw * mh);
+  if (!GP_ShapeDraw(s->shape, s->hx, s->hy, s->width, s->heigth, s->side,
+                    s->aa, 0xFFFF, GP_ShapeScratch, mw, mh) ||
+      !GP_CacheAlloc(&GP_ShapeCache, k, stride * mh))
+    return false;
+
+  m = GP_ShapePool + GP_ShapeEntries[k].offset;
+  memset(m, 0, stride * mh);
+  for (int32_t j = 0; j < mh; j++, m += stride) {
+    for (int32_t i = 0; i < mw; i++) {
+      uint32_t g = (*GP_PixelPtr(i, j, GP_ShapeScratch, mw, mh) >> 5) & 0x3F;
+      if (s->aa)
+        /* Green of white over black gives back the 5 bit alpha. */
+        m[i] = (uint8_t)((g * 32 + 31) / 63 * 8 - (g == 0x3F));
+      else if (g)
+        m[i >> 3] |= (uint8_t)(0x80 >> (i & 7));
+    }
+  }
+  GP_ShapeEntries[k].used = true;
+  return true;
+}
+
+/* Blits the mask of entry k centered at x, y. */
+static void GP_ShapeBlit(uint32_t k,
+                         int32_t x,
+                         int32_t y,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  const GP_SHAPE_KEY *s = &GP_ShapeKeys[k];
+  int32_t mw = 2 * s->hx + 1, mh = 2 * s->hy + 1;
+  uint32_t stride = s->aa ? (uint32_t)mw : (uint32_t)(mw + 7) / 8;
+  const uint8_t *m = GP_ShapePool + GP_ShapeEntries[k].offset;
+
+  x -= s->hx;
+  y -= s->hy;
+  if (x >= 0 && y >= 0 && x + mw <= (int32_t)w && y + mh <= (int32_t)h) {
+    /* On screen: set bits straight into the rows. */
+    int32_t step = GP_IsRotated() ? -1 : 1;
+    for (int32_t j = 0; j < mh; j++, m += stride) {
+      uint16_t *p = GP_PixelPtr(x, y + j, Buffer, w, h);
+      if (s->aa) {
+        for (int32_t i = 0; i < mw; i++, p += step)
+          if (m[i] == 255)
+            *p = color;
+          else if (m[i])
+            *p = GP_Blend565(*p, color, m[i]);
+        continue;
+      }
+      for (uint32_t b = 0; b < stride; b++) {
+        uint16_t *q = p + (int32_t)(8 * b) * step;
+        for (uint8_t bits = m[b]; bits; bits <<= 1, q += step)
+          if (bits & 0x80)
+            *q = color;
+      }
+    }
+    return;
+  }
+  for (int32_t j = 0; j < mh; j++, m += stride) {
+    int32_t run = -1;
+    if (y + j < 0 || y + j >= (int32_t)h)
+      continue;
+    for (int32_t i = 0; i <= mw; i++) {
+      uint8_t a = 0;
+      if (i < mw)
+        a = s->aa ? m[i] : ((m[i >> 3] << (i & 7)) & 0x80) ? 255 : 0;
+      if (a == 255) {
+        if (run < 0)
+          run = i;
+        continue;
+      }
+      if (run >= 0) {
+        GP_SetSpanH(x + run, x + i - 1, y + j, color, Buffer, w, h);
+        run = -1;
+      }
+      if (a)
+        GP_BlendPixel(x + i, y + j, color, a, Buffer, w, h);
+    }
+  }
+}
+
+void GP_PutShape(uint8_t shape,
+                 uint16_t x,
+                 uint16_t y,
+                 uint16_t width,
+                 uint16_t heigth,
+                 uint8_t side,
+                 bool aa,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h)
+{
+  int32_t hx, hy;
+  uint32_t k;
+
+  /* Parameters a shape does not use are not part of its key. */
+  if (shape == GP_SHAPE_CROSS || shape == GP_SHAPE_CIRCLE ||
+      shape == GP_SHAPE_FILLED_CIRCLE) {
+    heigth = 0;
+    side = 0;
+  }
+  if (shape != GP_SHAPE_CIRCLE && shape != GP_SHAPE_FILLED_CIRCLE &&
+      shape != GP_SHAPE_FILLED_ARROW && shape != GP_SHAPE_FILLED_TRIANGLE)
+    aa = false;
+
+  GP_ShapeCache.clock++;
+  for (k = 0; k < GP_SHAPE_CACHE_SLOTS; k++) {
+    const GP_SHAPE_KEY *s = &GP_ShapeKeys[k];
+    if (GP_ShapeEntries[k].used && s->shape == shape && s->width == width &&
+        s->heigth == heigth && s->side == side && s->aa == aa) {
+      GP_ShapeEntries[k].stamp = GP_ShapeCache.clock;
+      GP_ShapeCache.hits++;
+      GP_ShapeBlit(k, x, y, color, Buffer, w, h);
+      return;
+    }
+  }
+  GP_ShapeCache.misses++;
+
+  GP_ShapeExtent(shape, width, heigth, side, &hx, &hy);
+  if (2 * hx + 1 > GP_SHAPE_MAX || 2 * hy + 1 > GP_SHAPE_MAX) {
+    GP_ShapeDraw(shape, x, y, width, heigth, side, aa, color, Buffer, w, h);
+    return;
+  }
+  k = GP_CacheVictim(&GP_ShapeCache);
+  GP_ShapeKeys[k] = (GP_SHAPE_KEY){width, heigth, shape, side, aa,
+                                   (int16_t)hx, (int16_t)hy};
+  if (!GP_ShapeRaster(k)) {
+    GP_ShapeDraw(shape, x, y, width, heigth, side, aa, color, Buffer, w, h);
+    return;
+  }
+  GP_ShapeBlit(k, x, y, color, Buffer, w, h);
+}
+
+void GP_ShapeCacheStats(uint32_t *hits, uint32_t *misses)
+{
+  *hits = GP_ShapeCache.hits;
+  *misses = GP_ShapeCache.misses;
+}
+
+void GP_ShapeCacheClear(void)
+{
+  GP_CacheReset(&GP_ShapeCache);
+}
+
+/**
+ *	Flood fill. A scanline seed fill (Heckbert, Graphics Gems I): a stack
+ *	entry is a filled span of row y whose row y + dy is still to be looked
+ *	at. Every row is scanned once through a stepped pointer and written as
+ *	spans. The spans written are also marked in a bitmap over the bounds, so
+ *	that spans lost to a full stack are found again from this fill only. The
+ *	stack and the bitmap are given by the caller in a GP_FLOOD_FILL.
+ */
+
+typedef struct gp_flood
+{
+  uint16_t *Buffer;
+  uint32_t w, h;
+  int32_t l, t, r, b; /* Bounds of the fill, inclusive. */
+  uint16_t color, border;
+  GP_FLOOD_SPAN *spans;
+  uint32_t n, max;
+  bool overflow;
+  uint32_t *marks;
+  uint32_t stride; /* Mark bits of a row. */
+} GP_FLOOD;
+
+/* Sets (set) or tests the mark bits of x1..x2 on row y. */
+static bool GP_FloodMark(const GP_FLOOD *fl,
+                         int32_t x1,
+                         int32_t x2,
+                         int32_t y,
+                         bool set)
+{
+  uint32_t i = (uint32_t)(y - fl->t) * fl->stride + (uint32_t)(x1 - fl->l);
+  uint32_t e = i + (uint32_t)(x2 - x1);
+  uint32_t *m = fl->marks + i / 32;
+  uint32_t last = e / 32 - i / 32;
+
+  for (uint32_t k = 0; k <= last; k++) {
+    uint32_t bits = ~0u;
+
+    if (k == 0)
+      bits &= ~0u << (i % 32);
+    if (k == last)
+      bits &= ~0u >> (31 - e % 32);
+    if (set)
+      m[k] |= bits;
+    else if (m[k] & bits)
+      return true;
+  }
+  return false;
+}
+
+static inline bool GP_FloodInside(const GP_FLOOD *fl, uint16_t v)
+{
+  return v != fl->border && v != fl->color;
+}
+
+/* First x from x in direction dir that is not inside the area. */
+static int32_t GP_FloodEnd(const GP_FLOOD *fl,
+                           int32_t x,
+                           int32_t y,
+                           int32_t dir)
+{
+  int32_t end = dir > 0 ? fl->r + 1 : fl->l - 1;
+  int32_t step = GP_IsRotated() ? -dir : dir;
+  const uint16_t *p;
+
+  if (x == end)
+    return x;
+  p = GP_PixelPtr(x, y, fl->Buffer, fl->w, fl->h);
+  for (; x != end && GP_FloodInside(fl, *p); x += dir, p += step)
+    ;
+  return x;
+}
+
+/* First x of x..x2 inside the area, x2 + 1 if there is none. */
+static int32_t GP_FloodSkip(const GP_FLOOD *fl,
+                            int32_t x,
+                            int32_t x2,
+                            int32_t y)
+{
+  const uint16_t *p;
+  int32_t step = GP_IsRotated() ? -1 : 1;
+
+  if (x > x2)
+    return x;
+  p = GP_PixelPtr(x, y, fl->Buffer, fl->w, fl->h);
+  for (; x <= x2 && !GP_FloodInside(fl, *p); x++, p += step)
+    ;
+  return x;
+}
+
+static void GP_FloodPush(GP_FLOOD *fl,
+                         int32_t y,
+                         int32_t x1,
+                         int32_t x2,
+                         int32_t dy)
+{
+  if (y + dy < fl->t || y + dy > fl->b)
+    return;
+  if (fl->n == fl->max) {
+    fl->overflow = true;
+    return;
+  }
+  fl->spans[fl->n++] = (GP_FLOOD_SPAN){y, x1, x2, dy};
+}
+
+/* Fills the run from x on row y, pushes the rows next to it. */
+static int32_t GP_FloodRun(GP_FLOOD *fl,
+                           int32_t l,
+                           int32_t x,
+                           int32_t y,
+                           const GP_FLOOD_SPAN *s)
+{
+  x = GP_FloodEnd(fl, x, y, 1);
+  GP_SetSpanH(l, x - 1, y, fl->color, fl->Buffer, fl->w, fl->h);
+  GP_FloodMark(fl, l, x - 1, y, true);
+  GP_FloodPush(fl, y, l, x - 1, s->dy);
+  /* The run went past its parent: look back at the parent row too. */
+  if (x > s->x2 + 1)
+    GP_FloodPush(fl, y, s->x2 + 1, x - 1, -s->dy);
+  return x;
+}
+
+static void GP_FloodDrain(GP_FLOOD *fl)
+{
+  while (fl->n) {
+    GP_FLOOD_SPAN s = fl->spans[--fl->n];
+    int32_t y = s.y + s.dy;
+    int32_t x = GP_FloodEnd(fl, s.x1, y, -1);
+
+    if (x < s.x1) {
+      /* The run leaks left of its parent. */
+      if (x + 1 < s.x1)
+        GP_FloodPush(fl, y, x + 1, s.x1 - 1, -s.dy);
+      x = GP_FloodRun(fl, x + 1, s.x1 + 1, y, &s);
+    }
+    for (x = GP_FloodSkip(fl, x + 1, s.x2, y); x <= s.x2;
+         x = GP_FloodSkip(fl, x + 1, s.x2, y))
+      x = GP_FloodRun(fl, x, x, y, &s);
+  }
+}
+
+/*
+ * Seeds the runs that touch a pixel filled by this call above or below after
+ * the stack overflowed. Returns false when there were none; seeds that do
+ * not fit set the overflow again. The run itself is pushed first, so every
+ * round fills something.
+ */
+static bool GP_FloodReseed(GP_FLOOD *fl)
+{
+  bool found = false;
+
+  fl->overflow = false;
+  for (int32_t y = fl->t; y <= fl->b; y++) {
+    for (int32_t x = GP_FloodSkip(fl, fl->l, fl->r, y); x <= fl->r;
+         x = GP_FloodSkip(fl, x, fl->r, y)) {
+      int32_t e = GP_FloodEnd(fl, x, y, 1);
+
+      if ((y > fl->t && GP_FloodMark(fl, x, e - 1, y - 1, false)) ||
+          (y < fl->b && GP_FloodMark(fl, x, e - 1, y + 1, false))) {
+        GP_FloodPush(fl, y + 1, x, e - 1, -1);
+        GP_FloodPush(fl, y, x, e - 1, 1);
+        found = true;
+      }
+      x = e;
+    }
+  }
+  return found;
+}
+
+void GP_FloodFillInit(GP_FLOOD_FILL *fill,
+                      GP_FLOOD_SPAN *spans,
+                      uint32_t max,
+                      uint32_t *marks,
+                      uint32_t size)
+{
+  fill->spans = spans;
+  fill->max = max;
+  fill->marks = marks;
+  fill->size = size;
+}
+
+bool GP_FillArea(GP_FLOOD_FILL *fill,
+                 uint16_t x,
+                 uint16_t y,
+                 uint16_t heigth,
+                 uint16_t width,
+                 uint16_t color,
+                 uint16_t border_color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h)
+{
+  GP_FLOOD fl = {Buffer, w, h, x - width / 2, y - heigth / 2, 0, 0,
+                 color, border_color, fill->spans, 0, fill->max, false,
+                 fill->marks, 0};
+
+  fl.r = fl.l + width - 1;
+  fl.b = fl.t + heigth - 1;
+  if (fl.l < 0)
+    fl.l = 0;
+  if (fl.t < 0)
+    fl.t = 0;
+  if (fl.r >= (int32_t)w)
+    fl.r = (int32_t)w - 1;
+  if (fl.b >= (int32_t)h)
+    fl.b = (int32_t)h - 1;
+  if (x < fl.l || x > fl.r || y < fl.t || y > fl.b ||
+      !GP_FloodInside(&fl, *GP_PixelPtr(x, y, Buffer, w, h)))
+    return true;
+  fl.stride = (uint32_t)(fl.r - fl.l + 1);
+  if (fill->max == 0 ||
+      GP_FLOOD_MARK_WORDS(fl.stride, fl.b - fl.t + 1) > fill->size)
+    return false;
+  memset(fl.marks, 0,
+         sizeof(uint32_t) * GP_FLOOD_MARK_WORDS(fl.stride, fl.b - fl.t + 1));
+
+  GP_FloodPush(&fl, y + 1, x, x, -1);
+  GP_FloodPush(&fl, y, x, x, 1);
+  GP_FloodDrain(&fl);
+  /* Spans lost to a full stack are found again from the filled pixels. */
+  while (fl.overflow && GP_FloodReseed(&fl))
+    GP_FloodDrain(&fl);
+  return true;
+}
+
+/**
+ *	Glyph kernels. A byte of a glyph row becomes 8 pixels at once: a SIMD
+ *	compare against the bit of each lane and a blend of the two colors, or
+ *	two nibble masks of 4 pixels without SIMD. Transparent rows only visit
+ *	their set bits, run by run, by counting leading zeros.
+ */
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+/* Bit of each pixel of a byte in memory order, plain and rotated. */
+static const uint16_t GP_BitSel[2][8] = {
+  {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01},
+  {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80}};
+#else
+#define GP_NIB(n, a, b, c, d)                                                  \
+  {(n) & (a) ? 0xFFFF : 0, (n) & (b) ? 0xFFFF : 0, (n) & (c) ? 0xFFFF : 0,    \
+   (n) & (d) ? 0xFFFF : 0}
+#define GP_NIBS(a, b, c, d)                                                    \
+  {GP_NIB(0, a, b, c, d),  GP_NIB(1, a, b, c, d),  GP_NIB(2, a, b, c, d),     \
+   GP_NIB(3, a, b, c, d),  GP_NIB(4, a, b, c, d),  GP_NIB(5, a, b, c, d),     \
+   GP_NIB(6, a, b, c, d),  GP_NIB(7, a, b, c, d),  GP_NIB(8, a, b, c, d),     \
+   GP_NIB(9, a, b, c, d),  GP_NIB(10, a, b, c, d), GP_NIB(11, a, b, c, d),    \
+   GP_NIB(12, a, b, c, d), GP_NIB(13, a, b, c, d), GP_NIB(14, a, b, c, d),    \
+   GP_NIB(15, a, b, c, d)}
+
+/* Lane masks of 4 pixels from a nibble, plain and rotated. */
+static const uint16_t GP_NibMask[2][16][4] = {GP_NIBS(8, 4, 2, 1),
+                                              GP_NIBS(1, 2, 4, 8)};
+#endif
+
+static inline uint32_t GP_Clz32(uint32_t v)
+{
+#if defined(__GNUC__)
+  return (uint32_t)__builtin_clz(v);
+#else
+  uint32_t n = 0;
+
+  for (uint32_t s = 16; s; s >>= 1)
+    if (!(v >> (32 - s))) {
+      n += s;
+      v <<= s;
+    }
+  return n;
+#endif
+}
+
+/* Fills n pixels, short runs without the span kernel. */
+static inline void GP_PutRun(uint16_t *p, uint32_t n, uint16_t color)
+{
+  if (n >= 8) {
+    GP_FillSpan(p, n, color);
+    return;
+  }
+  while (n--)
+    *p++ = color;
+}
+
+/* 8 pixels from p in memory order from the bits of a glyph byte. */
+static inline void GP_ExpandByte(uint16_t *p,
+                                 uint8_t bits,
+                                 bool rotated,
+                                 uint16_t fg,
+                                 uint16_t bg)
+{
+#if defined(__SSE2__)
+  __m128i sel = _mm_loadu_si128((const __m128i *)GP_BitSel[rotated]);
+  __m128i m = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(bits), sel), sel);
+
+  _mm_storeu_si128((__m128i *)p,
+                   _mm_or_si128(_mm_and_si128(m, _mm_set1_epi16((short)fg)),
+                                _mm_andnot_si128(m, _mm_set1_epi16((short)bg))));
+#elif defined(__ARM_NEON)
+  uint16x8_t m = vtstq_u16(vdupq_n_u16(bits), vld1q_u16(GP_BitSel[rotated]));
+
+  vst1q_u16(p, vbslq_u16(m, vdupq_n_u16(fg), vdupq_n_u16(bg)));
+#else
+  uint64_t f4 = fg * 0x0001000100010001ULL, b4 = bg * 0x0001000100010001ULL;
+  uint8_t nib[2] = {(uint8_t)(bits >> 4), (uint8_t)(bits & 15)};
+
+  for (uint8_t k = 0; k < 2; k++) {
+    uint64_t m, v;
+    memcpy(&m, GP_NibMask[rotated][nib[k ^ rotated]], 8);
+    v = (f4 & m) | (b4 & ~m);
+    memcpy(p + 4 * k, &v, 8);
+  }
+#endif
+}
+
+/*
+ * Writes one opaque glyph row of n bytes at its first pixel p, closed by
+ * two background pixels as GP_PutChar always drew them.
+ */
+static inline void GP_GlyphRowOpaque(uint16_t *p,
+                                     const uint8_t *bits,
+                                     uint32_t n,
+                                     bool rotated,
+                                     uint16_t fg,
+                                     uint16_t bg)
+{
+  int32_t dir = rotated ? -1 : 1;
+
+  for (uint32_t j = 0; j < n; j++)
+    GP_ExpandByte(rotated ? p - 8 * j - 7 : p + 8 * j, bits[j], rotated, fg,
+                  bg);
+  p[dir * (int32_t)(8 * n)] = bg;
+  p[dir * (int32_t)(8 * n + 1)] = bg;
+}
+
+/* Writes one glyph row of n bytes at its first pixel p. */
+static void GP_GlyphRow(uint16_t *p,
+                        const uint8_t *bits,
+                        uint32_t n,
+                        bool rotated,
+                        bool transp,
+                        uint16_t fg,
+                        uint16_t bg)
+{
+  if (!transp) {
+    GP_GlyphRowOpaque(p, bits, n, rotated, fg, bg);
+    return;
+  }
+  for (uint32_t j = 0; j < n; j += 4) {
+    uint32_t row = 0;
+    for (uint32_t k = 0; k < 4; k++)
+      row = row << 8 | (j + k < n ? bits[j + k] : 0);
+    /* Runs of set bits, the first from the leading zeros. */
+    while (row) {
+      uint32_t s = GP_Clz32(row);
+      uint32_t len = row << s == 0xFFFFFFFF ? 32 : GP_Clz32(~(row << s));
+      int32_t x = (int32_t)(8 * j + s);
+      GP_PutRun(rotated ? p - x - (int32_t)len + 1 : p + x, len, fg);
+      row = s + len >= 32 ? 0 : row & (0xFFFFFFFF >> (s + len));
+    }
+  }
+}
+
+/**
+ *	Glyph cache. A glyph is kept as run lengths per row: a count, then the
+ *	runs alternating background and foreground, the background first. The
+ *	runs cover the whole box GP_PutChar writes, so a cached glyph is drawn
+ *	by spans only and in any colors. Transparent text only draws the
+ *	foreground runs; opaque text goes through the cache where it is clipped.
+ */
+
+#ifndef GP_GLYPH_CACHE_BYTES
+#define GP_GLYPH_CACHE_BYTES 8192 /**< Memory of the cached glyphs. */
+#endif
+#define GP_GLYPH_CACHE_SLOTS 128  /**< Max cached glyphs. */
+
+typedef struct gp_glyph_key
+{
+  const FONT *f;
+  uint8_t ch;
+} GP_GLYPH_KEY;
+
+static uint8_t GP_GlyphPool[GP_GLYPH_CACHE_BYTES];
+static GP_GLYPH_KEY GP_GlyphKeys[GP_GLYPH_CACHE_SLOTS];
+static GP_CACHE_ENTRY GP_GlyphEntries[GP_GLYPH_CACHE_SLOTS];
+static GP_CACHE GP_GlyphCache = {GP_GlyphPool, GP_GLYPH_CACHE_BYTES, 0,
+                                 GP_GlyphEntries, GP_GLYPH_CACHE_SLOTS,
+                                 0, 0, 0};
+/* Entry + 1 of each character of the font used last with it. */
+static uint8_t GP_GlyphMap[256];
+
+/*
+ * Run lengths of a glyph into out, or only their size when out is NULL.
+ * Returns 0 when a run does not fit in a byte.
+ */
+static uint32_t GP_GlyphRuns(const FONT *f, uint8_t Ch, uint8_t *out)
+{
+  const uint8_t *fPtr = f->Bitmap + f->FontChar[Ch].offset;
+  uint32_t width = (f->FontChar[Ch].width + 7) / 8;
+  uint32_t bytes = 0;
+
+  for (uint32_t i = 0; i < f->Heigth; i++, fPtr += width) {
+    uint8_t *count = out ? out + bytes : NULL;
+    uint32_t n = 0, len = 0;
+    bool fg = false;
+
+    bytes++;
+    /* Two background pixels close every row that has any. */
+    for (uint32_t k = 0; width && k < 8 * width + 2; k++) {
+      bool bit = k < 8 * width && (fPtr[k >> 3] & (0x80 >> (k & 7)));
+      if (bit != fg) {
+        if (out)
+          out[bytes] = (uint8_t)len;
+        bytes++;
+        n++;
+        fg = bit;
+        len = 0;
+      }
+      if (++len > 255)
+        return 0;
+    }
+    if (out) {
+      out[bytes] = (uint8_t)len;
+      *count = (uint8_t)(n + 1);
+    }
+    bytes++;
+  }
+  return bytes;
+}
+
+/* Index of the cached glyph, cached on a miss. -1 if it does not fit. */
+static int32_t GP_GlyphFind(const FONT *f, uint8_t Ch)
+{
+  uint32_t k = GP_GlyphMap[Ch], bytes;
+
+  GP_GlyphCache.clock++;
+  if (k && GP_GlyphEntries[k - 1].used && GP_GlyphKeys[k - 1].f == f &&
+      GP_GlyphKeys[k - 1].ch == Ch) {
+    GP_GlyphEntries[k - 1].stamp = GP_GlyphCache.clock;
+    GP_GlyphCache.hits++;
+    return (int32_t)k - 1;
+  }
+  /* The glyph may be cached for a font other than the last one. */
+  for (k = 0; k < GP_GLYPH_CACHE_SLOTS; k++) {
+    if (GP_GlyphEntries[k].used && GP_GlyphKeys[k].f == f &&
+        GP_GlyphKeys[k].ch == Ch) {
+      GP_GlyphEntries[k].stamp = GP_GlyphCache.clock;
+      GP_GlyphCache.hits++;
+      GP_GlyphMap[Ch] = (uint8_t)(k + 1);
+      return (int32_t)k;
+    }
+  }
+  GP_GlyphCache.misses++;
+
+  bytes = GP_GlyphRuns(f, Ch, NULL);
+  k = GP_CacheVictim(&GP_GlyphCache);
+  if (!bytes || !GP_CacheAlloc(&GP_GlyphCache, k, bytes))
+    return -1;
+  GP_GlyphRuns(f, Ch, GP_GlyphPool + GP_GlyphEntries[k].offset);
+  GP_GlyphKeys[k] = (GP_GLYPH_KEY){f, Ch};
+  GP_GlyphEntries[k].used = true;
+  GP_GlyphMap[Ch] = (uint8_t)(k + 1);
+  return (int32_t)k;
+}
+
+/* Draws the runs of a glyph at x, y, without the background if transp. */
+static void GP_GlyphBlit(const uint8_t *r,
+                         int32_t x,
+                         int32_t y,
+                         uint32_t rows,
+                         uint32_t len,
+                         bool transp,
+                         uint16_t color,
+                         uint16_t bg,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h)
+{
+  bool rotated = GP_IsRotated();
+
+  if (x < 0 || y < 0 || x + len > w || y + rows > h) {
+    for (uint32_t i = 0; i < rows; i++, r += *r + 1) {
+      int32_t xx = x;
+      for (uint32_t k = 1; k <= *r; xx += r[k], k++)
+        if (r[k] && !(transp && (k & 1)))
+          GP_SetSpanH(xx, xx + r[k] - 1, y + (int32_t)i, k & 1 ? bg : color,
+                      Buffer, w, h);
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < rows; i++, r += *r + 1) {
+    uint16_t *p = GP_PixelPtr(x, y + (int32_t)i, Buffer, w, h);
+    /* A rotated row is written from its right end, runs last first. */
+    if (rotated)
+      p -= len - 1;
+    for (uint32_t j = 0; j < *r; j++) {
+      uint32_t k = rotated ? *r - j : j + 1;
+      if (!(transp && (k & 1)))
+        GP_PutRun(p, r[k], k & 1 ? bg : color);
+      p += r[k];
+    }
+  }
+}
+
+/* Draws a glyph straight from its bits. */
+static void GP_PutCharBits(uint16_t x,
+                           uint16_t y,
+                           uint16_t color,
+                           uint16_t BcGrCol,
+                           bool transp,
+                           const uint8_t Ch,
+                           const FONT *f,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  const uint8_t *fPtr = f->Bitmap + f->FontChar[Ch].offset;
+  uint32_t width = (f->FontChar[Ch].width + 7) / 8;
+
+  if (!width)
+    return;
+  if (x + 8 * width + 2 <= w && y + f->Heigth <= h) {
+    for (uint32_t i = 0; i < f->Heigth; i++, fPtr += width)
+      GP_GlyphRow(GP_PixelPtr(x, y + i, Buffer, w, h), fPtr, width,
+                  GP_IsRotated(), transp, color, BcGrCol);
+    return;
+  }
+  for (uint32_t i = 0; i < f->Heigth; i++, fPtr += width) {
+    for (uint32_t k = 0; k < 8 * width + 2; k++) {
+      bool bit = k < 8 * width && (fPtr[k >> 3] & (0x80 >> (k & 7)));
+      if (bit || !transp)
+        GP_SetSpanH(x + k, x + k, y + i, bit ? color : BcGrCol, Buffer, w, h);
+    }
+  }
+}
+
+void GP_PutChar(uint16_t x,
+                uint16_t y,
+                uint16_t color,
+                const uint8_t Ch,
+                const FONT *f,
+                uint16_t *Buffer,
+                uint32_t w,
+                uint32_t h,
+                unsigned cbc)
+{
+  uint16_t BcGrCol = 0;
+  uint32_t len;
+  int32_t k;
+
+  if (!cbc && x < w && y < h)
+    BcGrCol = pGP_GetColor(x, y, Buffer, w, h);
+
+  /* On screen, expanding the bits is faster than replaying cached runs. */
+  len = 8 * ((f->FontChar[Ch].width + 7) / 8);
+  if (x + len + 2 <= w && y + f->Heigth <= h) {
+    GP_PutCharBits(x, y, color, BcGrCol, false, Ch, f, Buffer, w, h);
+    return;
+  }
+  k = GP_GlyphFind(f, Ch);
+  if (k < 0) {
+    GP_PutCharBits(x, y, color, BcGrCol, false, Ch, f, Buffer, w, h);
+    return;
+  }
+  GP_GlyphBlit(GP_GlyphPool + GP_GlyphEntries[k].offset, x, y, f->Heigth,
+               len ? len + 2 : 0, false, color, BcGrCol, Buffer, w, h);
+}
+
+void GP_PutCharTransp(uint16_t x,
+                      uint16_t y,
+                      uint16_t color,
+                      const uint8_t Ch,
+                      const FONT *f,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h)
+{
+  uint32_t len;
+  int32_t k = GP_GlyphFind(f, Ch);
+
+  if (k < 0) {
+    GP_PutCharBits(x, y, color, 0, true, Ch, f, Buffer, w, h);
+    return;
+  }
+  len = 8 * ((f->FontChar[Ch].width + 7) / 8);
+  GP_GlyphBlit(GP_GlyphPool + GP_GlyphEntries[k].offset, x, y, f->Heigth,
+               len ? len + 2 : 0, true, color, 0, Buffer, w, h);
+}
+
+void GP_GlyphCacheStats(uint32_t *hits, uint32_t *misses)
+{
+  *hits = GP_GlyphCache.hits;
+  *misses = GP_GlyphCache.misses;
+}
+
+void GP_GlyphCacheClear(void)
+{
+  GP_CacheReset(&GP_GlyphCache);
+  memset(GP_GlyphMap, 0, sizeof(GP_GlyphMap));
+}
 
-    break;
-  case SOUTH:
-    l_w = heigth;
-    l_h = width;
-    x0 = x;
-    y0 = y + l_h / 2;
-    x1_1 = x + l_w / 2;
-    y1_1 = y + l_h / 6;
-    x1_2 = x - l_w / 2;
-    y1_2 = y + l_h / 6;
-
-    x1 = x + l_w / 4;
-    y1 = y + l_h / 6;
-    x2 = x - l_w / 4;
-    y2 = y1;
-    x3 = x1;
-    y3 = y - l_h / 2;
-    x4 = x2;
-    y4 = y3;
+/**
+ *	String renderer. A string is laid out in chunks of glyph indices and x
+ *	positions once, and the backgrounds GP_PutChar would have read at the
+ *	glyph corners are worked out from the layout before anything is drawn.
+ *	Each glyph is then written down its rows with its padding in the same
+ *	pass. Glyph boxes overlap by their padding as they did char by char and
+ *	go in string order, so the last one still wins.
+ */
 
-    break;
-  case WEST:
-    l_w = width;
-    l_h = heigth;
+#define GP_TEXT_CHUNK 64 /* Glyphs laid out at once. */
 
-    x0 = x - l_w / 2;
-    y0 = y;
-    x1_1 = x - l_w / 6;
-    y1_1 = y + l_h / 2;
+static uint16_t GP_TextBg[GP_TEXT_CHUNK];
 
-    x1_2 = x - l_w / 6;
-    y1_2 = y - l_h / 2;
+/* Glyph of a char of the CP1251 layout of the fonts. */
+static inline uint8_t GP_CharIndex(uint8_t c)
+{
+  return c > 126 ? c - 96 : c - 32;
+}
 
-    x1 = x - l_w / 6;
-    y1 = y + l_h / 4;
-    x2 = x1;
-    y2 = y - l_h / 4;
-    x3 = x + l_w / 2;
-    y3 = y1;
-    x4 = x3;
-    y4 = y2;
+/* Pixels GP_PutChar writes per row of a glyph. */
+static inline int32_t GP_GlyphBox(const FONT *f, uint16_t Ch)
+{
+  int32_t n = 8 * ((f->FontChar[Ch].width + 7) / 8);
 
-    break;
-  case EAST:
-    l_w = width;
-    l_h = heigth;
+  return n ? n + 2 : 0;
+}
 
-    x0 = x + l_w / 2;
-    y0 = y;
-    x1_1 = x + l_w / 6;
-    y1_1 = y - l_h / 2;
-    x1_2 = x + l_w / 6;
-    y1_2 = y + l_h / 2;
-
-    x1 = x + l_w / 6;
-    y1 = y - l_h / 4;
-    x2 = x1;
-    y2 = y + l_h / 4;
-    x3 = x - l_w / 2;
-    y3 = y1;
-    x4 = x3;
-    y4 = y2;
-    break;
-  default:
-    return;
-  }
-  GP_SetBresenhamLine(x0, y0, x1_1, y1_1, color, Buffer, w, h);
-  GP_SetBresenhamLine(x0, y0, x1_2, y1_2, color, Buffer, w, h);
+/*
+ * Glyphs of codepoints. A font gets a two level table: the top level maps
+ * each 256 codepoints of the BMP to a block of glyphs, blocks are made for
+ * the codepoints the font has. Codepoints beyond the BMP, and blocks past
+ * GP_CMAP_BLOCKS, are found by a binary search of the font ranges. Tables
+ * of the last GP_CMAP_FONTS fonts are kept.
+ */
+
+#ifndef GP_CMAP_BLOCKS
+#define GP_CMAP_BLOCKS 8 /* Blocks of 256 codepoints, up to 254. */
+#endif
+#ifndef GP_CMAP_FONTS
+#define GP_CMAP_FONTS 4 /* Fonts with a table. */
+#endif
+#define GP_CMAP_SEARCH 0xFF /* Top level entry of a block left to search. */
+
+typedef struct gp_cmap
+{
+  const FONT *f;
+  const FONT_RANGE *r;
+  uint16_t n;
+  uint8_t top[256];                    /* Block + 1, 0 with no glyphs. */
+  uint16_t block[GP_CMAP_BLOCKS][256]; /* Glyph + 1, 0 with no glyph. */
+  int32_t ascii;   /* Glyph of ' ' if ' '..'~' are in order, else -1. */
+  int32_t missing; /* Glyph of '?' put for codepoints not in the font. */
+  uint32_t used;   /* Time of the last use, 0 for a free table. */
+} GP_CMAP;
+
+static GP_CMAP GP_Cmaps[GP_CMAP_FONTS];
+static uint32_t GP_CmapTime;
 
-  GP_SetBresenhamLine(x1_1, y1_1, x1, y1, color, Buffer, w, h);
-  GP_SetBresenhamLine(x2, y2, x1_2, y1_2, color, Buffer, w, h);
+/* Codepoints of fonts without ranges, in the layout GP_CharIndex reads. */
+static const FONT_RANGE GP_Cp1251Ranges[] = {
+    {0x0020, 95, 0}, {0x0401, 1, 95}, {0x0410, 64, 96}, {0x0451, 1, 160}};
 
-  GP_SetBresenhamLine(x1, y1, x3, y3, color, Buffer, w, h);
-  GP_SetBresenhamLine(x2, y2, x4, y4, color, Buffer, w, h);
+/* Glyph of the codepoint cp, -1 if the font has none. */
+static int32_t GP_CmapFind(const GP_CMAP *m, uint32_t cp)
+{
+  uint32_t lo = 0, hi = m->n;
 
-  GP_SetBresenhamLine(x3, y3, x4, y4, color, Buffer, w, h);
+  if (cp < 0x10000 && m->top[cp >> 8] != GP_CMAP_SEARCH) {
+    uint8_t t = m->top[cp >> 8];
+    return t ? (int32_t)m->block[t - 1][cp & 255] - 1 : -1;
+  }
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (cp < m->r[mid].first)
+      hi = mid;
+    else if (cp - m->r[mid].first >= m->r[mid].count)
+      lo = mid + 1;
+    else
+      return m->r[mid].glyph + (int32_t)(cp - m->r[mid].first);
+  }
+  return -1;
 }
 
-void GP_FillArea(uint16_t x,
-                 uint16_t y,
-                 uint16_t heigth,
-                 uint16_t width,
-                 uint16_t color,
-                 uint16_t border_color,
-                 uint16_t *Buffer,
-                 uint32_t w,
-                 uint32_t h)
+/* Table of a font, built in place of the least recently used one. */
+static const GP_CMAP *GP_FontCmap(const FONT *f)
 {
-  uint16_t x1 = x;
-  uint16_t y1 = y;
-  bool xflag = false;
-  bool yflag = false;
-  for (y1 = y; y1 < y + heigth / 2; y1++) {
-    if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-      yflag = true;
-    }
-    for (x1 = x; x1 < x + width / 2; x1++) {
-      if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-        xflag = true;
-      }
-      if ((!xflag) && (!yflag)) {
-        pGP_SetPixel(x1, y1, color, Buffer, w, h);
+  GP_CMAP *m = &GP_Cmaps[0];
+  uint32_t blocks = 0;
+
+  for (uint32_t i = 0; i < GP_CMAP_FONTS; i++) {
+    if (GP_Cmaps[i].used && GP_Cmaps[i].f == f) {
+      GP_Cmaps[i].used = ++GP_CmapTime;
+      return &GP_Cmaps[i];
+    }
+    if (GP_Cmaps[i].used < m->used)
+      m = &GP_Cmaps[i];
+  }
+  /* After a wrap of the clock every table is as old as the others. */
+  if (GP_CmapTime == UINT32_MAX) {
+    GP_CmapTime = 0;
+    for (uint32_t i = 0; i < GP_CMAP_FONTS; i++)
+      if (GP_Cmaps[i].used)
+        GP_Cmaps[i].used = 1;
+  }
+  m->used = ++GP_CmapTime;
+  m->f = f;
+  m->r = f->Ranges ? f->Ranges : GP_Cp1251Ranges;
+  m->n = f->Ranges ? f->RangeCount
+                   : sizeof(GP_Cp1251Ranges) / sizeof(GP_Cp1251Ranges[0]);
+  memset(m->top, 0, sizeof(m->top));
+  for (uint32_t i = 0; i < m->n; i++) {
+    for (uint32_t k = 0; k < m->r[i].count; k++) {
+      uint32_t cp = m->r[i].first + k;
+      uint8_t *t;
+
+      if (cp > 0xFFFF)
+        break;
+      t = &m->top[cp >> 8];
+      if (!*t) {
+        if (blocks < GP_CMAP_BLOCKS) {
+          memset(m->block[blocks], 0, sizeof(m->block[0]));
+          *t = (uint8_t)++blocks;
+        } else {
+          *t = GP_CMAP_SEARCH;
+        }
       }
+      if (*t != GP_CMAP_SEARCH)
+        m->block[*t - 1][cp & 255] = m->r[i].glyph + k + 1;
     }
-    xflag = false;
-    x1 = x;
   }
 
-  xflag = false;
-  yflag = false;
+  m->ascii = GP_CmapFind(m, ' ');
+  for (uint32_t c = '!'; c <= '~' && m->ascii >= 0; c++)
+    if (GP_CmapFind(m, c) != m->ascii + (int32_t)(c - ' '))
+      m->ascii = -1;
+  m->missing = GP_CmapFind(m, '?');
+  return m;
+}
 
-  for (y1 = y - 1; y1 > y - heigth / 2; y1--) {
-    if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-      yflag = true;
-    }
+/* Next codepoint of UTF-8 chars from *s to end, U+FFFD for bad bytes. */
+static uint32_t GP_Utf8Next(const uint8_t **s, const uint8_t *end)
+{
+  const uint8_t *p = *s;
+  uint32_t c = *p++, n, min;
 
-    for (x1 = x - 1; x1 > x - width / 2; x1--) {
-      if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-        xflag = true;
-      }
-      if ((!xflag) && (!yflag)) {
-        pGP_SetPixel(x1, y1, color, Buffer, w, h);
-      }
+  if (c < 0x80) {
+    *s = p;
+    return c;
+  }
+  if (c >= 0xC2 && c < 0xE0) {
+    n = 1;
+    c &= 0x1F;
+    min = 0x80;
+  } else if (c >= 0xE0 && c < 0xF0) {
+    n = 2;
+    c &= 0x0F;
+    min = 0x800;
+  } else if (c >= 0xF0 && c < 0xF5) {
+    n = 3;
+    c &= 0x07;
+    min = 0x10000;
+  } else {
+    *s = p;
+    return 0xFFFD;
+  }
+  /* A byte that does not continue the char starts the next one. */
+  for (; n; n--, p++) {
+    if (p >= end || (*p & 0xC0) != 0x80) {
+      *s = p;
+      return 0xFFFD;
     }
-    xflag = false;
-    x1 = x - 1;
+    c = c << 6 | (*p & 0x3F);
   }
+  *s = p;
+  if (c < min || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000))
+    return 0xFFFD;
+  return c;
+}
+
+/* Glyphs of 16 chars at p if all of them are ' '..'~', from base on. */
+static inline bool GP_DecodeAscii(const uint8_t *p,
+                                  uint16_t *glyph,
+                                  uint16_t base)
+{
+#if defined(__SSE2__)
+  __m128i t = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)p),
+                           _mm_set1_epi8(' '));
+  /* Unsigned t < 95 as a signed compare. */
+  __m128i in = _mm_cmplt_epi8(_mm_xor_si128(t, _mm_set1_epi8((char)0x80)),
+                              _mm_set1_epi8((char)(95 ^ 0x80)));
+  __m128i b = _mm_set1_epi16((short)base), z = _mm_setzero_si128();
+
+  if (_mm_movemask_epi8(in) != 0xFFFF)
+    return false;
+  _mm_storeu_si128((__m128i *)glyph, _mm_add_epi16(_mm_unpacklo_epi8(t, z), b));
+  _mm_storeu_si128((__m128i *)(glyph + 8),
+                   _mm_add_epi16(_mm_unpackhi_epi8(t, z), b));
+  return true;
+#elif defined(__ARM_NEON)
+  uint8x16_t t = vsubq_u8(vld1q_u8(p), vdupq_n_u8(' '));
+  uint64x2_t in = vreinterpretq_u64_u8(vcltq_u8(t, vdupq_n_u8(95)));
+  uint16x8_t b = vdupq_n_u16(base);
+
+  if ((vgetq_lane_u64(in, 0) & vgetq_lane_u64(in, 1)) != ~(uint64_t)0)
+    return false;
+  vst1q_u16(glyph, vaddq_u16(vmovl_u8(vget_low_u8(t)), b));
+  vst1q_u16(glyph + 8, vaddq_u16(vmovl_u8(vget_high_u8(t)), b));
+  return true;
+#else
+  for (uint32_t i = 0; i < 16; i++)
+    if (p[i] < ' ' || p[i] > '~')
+      return false;
+  for (uint32_t i = 0; i < 16; i++)
+    glyph[i] = base + p[i] - ' ';
+  return true;
+#endif
+}
 
-  xflag = false;
-  yflag = false;
-  x1 = x + 1;
-  y1 = y - 1;
+/*
+ * Glyphs of up to max chars from *s to end, returns how many. UTF-8 chars
+ * not in the font are put as '?', or left out if it has no '?'.
+ */
+static uint32_t GP_TextDecode(const uint8_t **s,
+                              const uint8_t *end,
+                              const FONT *f,
+                              bool utf8,
+                              uint16_t *glyph,
+                              uint32_t max)
+{
+  const GP_CMAP *m;
+  uint32_t n = 0;
 
-  for (y1 = y - 1; y1 > (y - heigth / 2); y1--) {
-    if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-      yflag = true;
+  if (!utf8) {
+    for (; n < max && *s < end; (*s)++)
+      glyph[n++] = GP_CharIndex(**s);
+    return n;
+  }
+  m = GP_FontCmap(f);
+  while (n < max && *s < end) {
+    int32_t g;
+    if (m->ascii >= 0 && end - *s >= 16 && max - n >= 16 &&
+        GP_DecodeAscii(*s, glyph + n, (uint16_t)m->ascii)) {
+      *s += 16;
+      n += 16;
+      continue;
     }
+    g = GP_CmapFind(m, GP_Utf8Next(s, end));
+    if (g < 0)
+      g = m->missing;
+    if (g >= 0)
+      glyph[n++] = (uint16_t)g;
+  }
+  return n;
+}
 
-    for (x1 = x; x1 < x + width / 2; x1++) {
-      if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-        xflag = true;
-      }
-      if ((!xflag) && (!yflag)) {
-        pGP_SetPixel(x1, y1, color, Buffer, w, h);
-      }
+/*
+ * Background of glyph i as GP_PutChar would read it at its corner after
+ * the glyphs before it: the last earlier box over the corner gives it.
+ */
+static uint16_t GP_TextCornerBg(const FONT *f,
+                                const GP_TEXT_GLYPH *g,
+                                uint32_t i,
+                                int32_t x,
+                                int32_t y,
+                                uint16_t color,
+                                uint16_t *Buffer,
+                                uint32_t w,
+                                uint32_t h)
+{
+  int32_t cx = x + g[i].x;
+
+  while (i--) {
+    int32_t k = cx - x - g[i].x, len = GP_GlyphBox(f, g[i].ch);
+    if (k >= 0 && k < len) {
+      const uint8_t *bits = f->Bitmap + f->FontChar[g[i].ch].offset;
+      if (k < len - 2 && (bits[k >> 3] & (0x80 >> (k & 7))))
+        return color;
+      return GP_TextBg[i];
     }
-    xflag = false;
-    x1 = x;
   }
+  if (cx < 0 || y < 0 || cx >= (int32_t)w || y >= (int32_t)h)
+    return 0;
+  return pGP_GetColor(cx, y, Buffer, w, h);
+}
 
-  xflag = false;
-  yflag = false;
+/* Draws n glyphs laid out from x, y, opaque as GP_PutChar. */
+static void GP_TextRows(const FONT *f,
+                        const GP_TEXT_GLYPH *g,
+                        uint32_t n,
+                        int32_t x,
+                        int32_t y,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h,
+                        unsigned cbc)
+{
+  int32_t r0 = y < 0 ? -y : 0;
+  int32_t r1 = y + f->Heigth > (int32_t)h ? (int32_t)h - y : f->Heigth;
+  bool rotated = GP_IsRotated();
+  int32_t step = rotated ? -(int32_t)w : (int32_t)w;
 
-  x1 = x - 1;
-  y1 = y + 1;
+  for (uint32_t i = 0; i < n; i++)
+    GP_TextBg[i] = cbc ? 0
+                       : GP_TextCornerBg(f, g, i, x, y, color, Buffer, w, h);
+  if (r0 >= r1)
+    return;
 
-  for (y1 = y; y1 < y + heigth / 2; y1++) {
-    if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-      yflag = true;
+  for (uint32_t i = 0; i < n; i++) {
+    int32_t gx = x + g[i].x, len = GP_GlyphBox(f, g[i].ch);
+    uint32_t bytes = len ? (len - 2) / 8 : 0;
+    const uint8_t *bits = f->Bitmap + f->FontChar[g[i].ch].offset + r0 * bytes;
+    if (!len || gx + len <= 0 || gx >= (int32_t)w)
+      continue;
+    if (gx >= 0 && gx + len <= (int32_t)w) {
+      uint16_t *p = GP_PixelPtr(gx, y + r0, Buffer, w, h);
+      for (int32_t r = r0; r < r1; r++, p += step, bits += bytes)
+        GP_GlyphRowOpaque(p, bits, bytes, rotated, color, GP_TextBg[i]);
+      continue;
     }
-    for (x1 = x - 1; x1 > x - width / 2; x1--) {
-      if (border_color == pGP_GetColor(x1, y1, Buffer, w, h)) {
-        xflag = true;
-      }
-      if ((!xflag) && (!yflag)) {
-        pGP_SetPixel(x1, y1, color, Buffer, w, h);
+    /* Cut by a side of the buffer. */
+    for (int32_t r = r0; r < r1; r++, bits += bytes)
+      for (int32_t k = 0; k < len; k++) {
+        bool bit = k < len - 2 && (bits[k >> 3] & (0x80 >> (k & 7)));
+        GP_SetSpanH(gx + k, gx + k, y + r, bit ? color : GP_TextBg[i], Buffer,
+                    w, h);
       }
+  }
+}
+
+/* Font metrics of the last font asked for. */
+static const FONT *GP_MetricFont;
+static uint8_t GP_MetricBaseline;
+
+/* Rows from the top of a font to its baseline, under the ink of 'H'. */
+static uint8_t GP_FontBaseline(const FONT *f)
+{
+  const FONT_CHAR *c = &f->FontChar[GP_CharIndex('H')];
+  uint32_t bytes = (c->width + 7) / 8;
+  uint8_t r = f->Heigth;
+
+  if (f == GP_MetricFont)
+    return GP_MetricBaseline;
+  while (r && bytes) {
+    const uint8_t *bits = f->Bitmap + c->offset + (r - 1) * bytes;
+    uint32_t j = 0;
+    while (j < bytes && !bits[j])
+      j++;
+    if (j < bytes)
+      break;
+    r--;
+  }
+  GP_MetricFont = f;
+  GP_MetricBaseline = r ? r : f->Heigth;
+  return GP_MetricBaseline;
+}
+
+/*
+ * Lays out up to max chars from *s to end at x on, returns how many
+ * glyphs it put. Offsets past UINT16_MAX stay at it.
+ */
+static uint32_t GP_TextLayoutRun(const uint8_t **s,
+                                 const uint8_t *end,
+                                 bool utf8,
+                                 const FONT *f,
+                                 GP_TEXT_GLYPH *g,
+                                 uint32_t max,
+                                 uint32_t *x)
+{
+  uint16_t ch[GP_TEXT_CHUNK];
+  uint32_t n = 0;
+
+  while (n < max && *s < end) {
+    uint32_t k = GP_TextDecode(s, end, f, utf8, ch,
+                               max - n < GP_TEXT_CHUNK ? max - n
+                                                       : GP_TEXT_CHUNK);
+    for (uint32_t i = 0; i < k; i++, n++) {
+      g[n].x = *x < UINT16_MAX ? (uint16_t)*x : UINT16_MAX;
+      g[n].ch = ch[i];
+      *x += f->FontChar[ch[i]].width + 2;
     }
-    xflag = false;
-    x1 = x - 1;
   }
+  return n;
 }
 
-void GP_PutChar(uint16_t x,
-                uint16_t y,
-                uint16_t color,
-                const uint8_t Ch,
-                const FONT *f,
-                uint16_t *Buffer,
-                uint32_t w,
-                uint32_t h,
-                unsigned cbc)
+/* Width of the chars from s to end. */
+static uint16_t GP_TextMeasure(const uint8_t *s,
+                               const uint8_t *end,
+                               bool utf8,
+                               const FONT *f)
 {
-  const uint8_t *fPtr = f->Bitmap;
-  uint8_t mask = 0x80;
-  uint8_t width;
+  uint16_t ch[GP_TEXT_CHUNK];
+  uint32_t width = 0;
 
-  fPtr += f->FontChar[Ch].offset;
+  while (s < end && width <= UINT16_MAX) {
+    uint32_t k = GP_TextDecode(&s, end, f, utf8, ch, GP_TEXT_CHUNK);
+    for (uint32_t i = 0; i < k; i++)
+      width += f->FontChar[ch[i]].width + 2;
+  }
+  return width > UINT16_MAX ? UINT16_MAX : (uint16_t)width;
+}
 
-  width = f->FontChar[Ch].width / 8;
-  if (f->FontChar[Ch].width % 8 != 0)
-    width++;
+/* Origin of a text of width pixels at x, y by align. */
+static void GP_TextAlign(int32_t *x,
+                         int32_t *y,
+                         uint32_t width,
+                         uint8_t align,
+                         const FONT *f)
+{
+  switch (align & GP_ALIGN_HMASK) {
+  case GP_ALIGN_CENTER:
+    *x -= (int32_t)width / 2;
+    break;
+  case GP_ALIGN_RIGHT:
+    *x -= (int32_t)width;
+    break;
+  }
+  switch (align & GP_ALIGN_VMASK) {
+  case GP_ALIGN_MIDDLE:
+    *y -= f->Heigth / 2;
+    break;
+  case GP_ALIGN_BOTTOM:
+    *y -= f->Heigth;
+    break;
+  case GP_ALIGN_BASELINE:
+    *y -= GP_FontBaseline(f);
+    break;
+  }
+}
 
-  uint16_t BcGrCol = 0;
-  if (!cbc)
-    BcGrCol = pGP_GetColor(x, y, Buffer, w, h);
+/*
+ * Draws a string from x, y aligned by align. The first chunk is laid out
+ * before anything is drawn, so strings that fit it are walked once.
+ */
+static void GP_TextString(int32_t x,
+                          int32_t y,
+                          uint8_t align,
+                          uint16_t color,
+                          const uint8_t *String,
+                          bool utf8,
+                          const FONT *f,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h,
+                          unsigned cbc)
+{
+  GP_TEXT_GLYPH g[GP_TEXT_CHUNK];
+  const uint8_t *end = String + strlen((const char *)String);
+  uint32_t cx = 0;
+  uint32_t n = GP_TextLayoutRun(&String, end, utf8, f, g, GP_TEXT_CHUNK, &cx);
 
-  for (uint16_t i = 0; i < f->Heigth; i++)
-  {
-    for (uint16_t j = 0; j < width; j++)
-    {
-      for (uint16_t k = 0; k < 8; k++) {
-        if (*fPtr & mask) {
-          pGP_SetPixel(x, y, color, Buffer, w, h);
-        } else {
-            pGP_SetPixel(x, y, BcGrCol, Buffer, w, h);
-        }
-        x++;
-        mask >>= 0x01;
-      }
-      pGP_SetPixel(x, y, BcGrCol, Buffer, w, h);
-      pGP_SetPixel(x + 1, y, BcGrCol, Buffer, w, h);
-      mask = 0x80;
-      fPtr++;
-    }
-    y++;
-    x -= 8 * width;
+  /* Only the rest of a long string is walked twice, to align it. */
+  GP_TextAlign(&x, &y,
+               align & GP_ALIGN_HMASK
+                   ? cx + GP_TextMeasure(String, end, utf8, f)
+                   : cx,
+               align, f);
+  while (n && x + (int32_t)g[0].x < (int32_t)w) {
+    GP_TextRows(f, g, n, x, y, color, Buffer, w, h, cbc);
+    n = GP_TextLayoutRun(&String, end, utf8, f, g, GP_TEXT_CHUNK, &cx);
   }
 }
 
@@ -695,21 +5494,8 @@ void GP_PutString(uint16_t x,
                   uint32_t h,
                   unsigned cbc)
 {
-  uint8_t Ch;
-
-  while (*String != 0)
-  {
-    Ch = (uint8_t)(*String);
-
-    if (Ch > 126) {
-      Ch -= 96;
-    } else {
-      Ch -= 32;
-    }
-   GP_PutChar(x, y, color, Ch, f, Buffer, w, h, cbc);
-    x += f->FontChar[Ch].width + 2;
-    String++;
-  }
+  GP_TextString(x, y, GP_ALIGN_LEFT | GP_ALIGN_TOP, color, String, false, f,
+                Buffer, w, h, cbc);
 }
 
 void GP_PutStringInTheCenter(uint16_t x,
@@ -722,41 +5508,452 @@ void GP_PutStringInTheCenter(uint16_t x,
                              uint32_t h,
                              unsigned cbc)
 {
-  uint16_t SLP = 0; // String Lenghth in pixels
-  const uint8_t *StrPtr = String;
-  uint8_t Ch;
-  uint32_t xx;
-  uint32_t yy;
+  GP_TextString(x, y, GP_ALIGN_CENTER | GP_ALIGN_MIDDLE, color, String, false,
+                f, Buffer, w, h, cbc);
+}
+
+void GP_PutStringAligned(int16_t x,
+                         int16_t y,
+                         uint8_t align,
+                         uint16_t color,
+                         const uint8_t *String,
+                         const FONT *f,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h,
+                         unsigned cbc)
+{
+  GP_TextString(x, y, align, color, String, false, f, Buffer, w, h, cbc);
+}
+
+void GP_PutStringUTF8(int16_t x,
+                      int16_t y,
+                      uint8_t align,
+                      uint16_t color,
+                      const uint8_t *String,
+                      const FONT *f,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h,
+                      unsigned cbc)
+{
+  GP_TextString(x, y, align, color, String, true, f, Buffer, w, h, cbc);
+}
+
+uint16_t GP_MeasureString(const uint8_t *String, const FONT *f)
+{
+  return GP_TextMeasure(String, String + strlen((const char *)String), false,
+                        f);
+}
+
+uint16_t GP_MeasureStringUTF8(const uint8_t *String, const FONT *f)
+{
+  return GP_TextMeasure(String, String + strlen((const char *)String), true,
+                        f);
+}
+
+int32_t GP_FontGlyph(const FONT *f, uint32_t cp)
+{
+  return GP_CmapFind(GP_FontCmap(f), cp);
+}
+
+void GP_TextInit(GP_TEXT *text, GP_TEXT_GLYPH *glyphs, uint16_t max)
+{
+  text->f = NULL;
+  text->glyphs = glyphs;
+  text->n = 0;
+  text->max = max;
+  text->width = 0;
+  text->baseline = 0;
+  text->overflow = false;
+}
+
+/* Lays out a string in a text. */
+static void GP_TextLayoutAs(GP_TEXT *text,
+                            const uint8_t *String,
+                            bool utf8,
+                            const FONT *f)
+{
+  const uint8_t *end = String + strlen((const char *)String);
+  uint32_t x = 0;
+
+  text->f = f;
+  text->n =
+      GP_TextLayoutRun(&String, end, utf8, f, text->glyphs, text->max, &x);
+  text->width = x > UINT16_MAX ? UINT16_MAX : (uint16_t)x;
+  text->baseline = GP_FontBaseline(f);
+  text->overflow = String < end;
+}
+
+void GP_TextLayout(GP_TEXT *text, const uint8_t *String, const FONT *f)
+{
+  GP_TextLayoutAs(text, String, false, f);
+}
+
+void GP_TextLayoutUTF8(GP_TEXT *text, const uint8_t *String, const FONT *f)
+{
+  GP_TextLayoutAs(text, String, true, f);
+}
+
+void GP_DrawText(const GP_TEXT *text,
+                 int16_t x,
+                 int16_t y,
+                 uint8_t align,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h,
+                 unsigned cbc)
+{
+  int32_t tx = x, ty = y;
 
-  if (*String == 0)
+  if (!text->n)
     return;
-  do {
+  GP_TextAlign(&tx, &ty, text->width, align, text->f);
+  for (uint32_t i = 0; i < text->n && tx + text->glyphs[i].x < (int32_t)w;
+       i += GP_TEXT_CHUNK) {
+    uint32_t n = text->n - i < GP_TEXT_CHUNK ? text->n - i : GP_TEXT_CHUNK;
+    GP_TextRows(text->f, text->glyphs + i, n, tx, ty, color, Buffer, w, h,
+                cbc);
+  }
+}
+
+/**
+ *	Text box. Chars are kept with paragraphs ended by '\n' and wrapped into
+ *	lines of the box. An edit wraps again only the paragraphs it touches and
+ *	marks the lines whose text or row changed; a draw writes just those and
+ *	scrolls the rest by moving their pixels.
+ */
 
-    Ch = (uint8_t)(*StrPtr);
+/* Chars of the line from s up to e that fit the box, and the next line. */
+static uint16_t GP_TextBoxWrapLine(const GP_TEXT_BOX *box,
+                                   uint16_t s,
+                                   uint16_t e,
+                                   uint16_t *len)
+{
+  uint32_t x = 0;
+  uint16_t i, brk = s;
 
-    if (Ch > 126)
-      Ch -= 96;
-    else
-      Ch -= 32;
-    SLP += f->FontChar[Ch].width + 2;
-    StrPtr++;
-  } while (*StrPtr != '\0');
+  for (i = s; i < e; i++) {
+    uint8_t cw = box->f->FontChar[GP_CharIndex(box->chars[i])].width;
+    if (box->chars[i] == ' ')
+      brk = i;
+    if (x + cw > box->width && i > s)
+      break;
+    x += cw + 2;
+  }
+  if (i == e) {
+    *len = e - s;
+    return e;
+  }
+  /* Words go whole to the next line, longer ones are cut. */
+  if (brk > s)
+    i = brk;
+  *len = i - s;
+  while (i < e && box->chars[i] == ' ')
+    i++;
+  return i;
+}
+
+/*
+ * Wraps the paragraphs of the chars s..e into lines from L, and returns
+ * their count. With store, lines below max are written, and a line keeps
+ * its dirty flag only when its chars are left as the edit of the chars
+ * at..at + count - 1 to at..at_end - 1 found them, in the same row.
+ */
+static uint32_t GP_TextBoxFlow(GP_TEXT_BOX *box,
+                               uint16_t s,
+                               uint16_t e,
+                               uint32_t L,
+                               uint32_t old_end,
+                               uint16_t at,
+                               uint16_t at_end,
+                               int32_t delta,
+                               bool store)
+{
+  uint32_t k = 0;
 
-  StrPtr = String;
-  xx = x - SLP / 2;
-  yy = y - f->Heigth / 2;
+  for (;;) {
+    uint16_t pe = s;
+    while (pe < e && box->chars[pe] != '\n')
+      pe++;
+    do {
+      uint16_t len, next = GP_TextBoxWrapLine(box, s, pe, &len);
+      uint32_t i = L + k++;
+      if (store && i < box->max) {
+        GP_TEXT_LINE *l = &box->lines[i];
+        bool same = i < old_end && l->len == len &&
+                    ((s + len <= at && l->start == s) ||
+                     (s >= at_end && l->start + delta == s));
+        l->dirty = !same || l->dirty;
+        l->start = s;
+        l->len = len;
+      }
+      s = next;
+    } while (s < pe);
+    if (pe >= e)
+      return k;
+    s = pe + 1;
+  }
+}
 
-  do {
-    Ch = (uint8_t)(*StrPtr);
+/* First line starting at or after the char s. */
+static uint32_t GP_TextBoxLineAt(const GP_TEXT_BOX *box, uint32_t s)
+{
+  uint32_t lo = 0, hi = box->n;
 
-    if (Ch > 126)
-      Ch -= 96;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (box->lines[mid].start < s)
+      lo = mid + 1;
     else
-      Ch -= 32;
-    GP_PutChar(xx, yy, color, Ch, f, Buffer, w, h, cbc);
-    xx += f->FontChar[Ch].width + 2;
-    StrPtr++;
-  } while (*StrPtr != '\0');
+      hi = mid;
+  }
+  return lo;
+}
+
+/*
+ * Drops the first paragraph if it ends before the char limit. Returns the
+ * chars dropped and the lines dropped in *lines, 0 if it does not.
+ */
+static uint16_t GP_TextBoxDrop(GP_TEXT_BOX *box,
+                               uint16_t limit,
+                               uint32_t *lines)
+{
+  uint16_t p = 0;
+  uint32_t m;
+
+  while (p < limit && box->chars[p] != '\n')
+    p++;
+  if (p >= limit)
+    return 0;
+  p++;
+  m = GP_TextBoxLineAt(box, p);
+  memmove(box->chars, box->chars + p, box->len - p);
+  box->len -= p;
+  memmove(box->lines, box->lines + m, (box->n - m) * sizeof(GP_TEXT_LINE));
+  box->n -= m;
+  for (uint32_t i = 0; i < box->n; i++)
+    box->lines[i].start -= p;
+  /* What is on the screen stays, so the lines shown move up too. */
+  box->first -= box->first < m ? box->first : m;
+  box->drawn -= (int32_t)m;
+  *lines = m;
+  return p;
+}
+
+/* Replaces count chars at at by String and wraps the paragraphs touched. */
+static void GP_TextBoxEdit(GP_TEXT_BOX *box,
+                           uint16_t at,
+                           uint16_t count,
+                           const uint8_t *String,
+                           bool drop)
+{
+  uint32_t slen = strlen((const char *)String), rows, k, t, m;
+  uint32_t L0, L1, tail;
+  uint16_t ps, pe, d;
+  int32_t delta;
+
+  if (at > box->len)
+    at = box->len;
+  if (count > box->len - at)
+    count = box->len - at;
+  while (box->len - count + slen > box->size) {
+    if (!drop || !(d = GP_TextBoxDrop(box, at, &m))) {
+      box->overflow = true;
+      slen = box->size - (box->len - count);
+      break;
+    }
+    at -= d;
+  }
+
+  /* Old lines of the paragraphs touched are L0..L1 - 1. */
+  ps = at;
+  while (ps && box->chars[ps - 1] != '\n')
+    ps--;
+  pe = at + count;
+  while (pe < box->len && box->chars[pe] != '\n')
+    pe++;
+  L0 = GP_TextBoxLineAt(box, ps);
+  L1 = GP_TextBoxLineAt(box, pe + 1);
+
+  delta = (int32_t)slen - count;
+  memmove(box->chars + at + slen, box->chars + at + count,
+          box->len - at - count);
+  for (uint32_t i = 0; i < slen; i++)
+    box->chars[at + i] =
+        String[i] < ' ' && String[i] != '\n' ? ' ' : String[i];
+  box->len += delta;
+  pe += delta;
+
+  k = GP_TextBoxFlow(box, ps, pe, L0, L1, at, at + slen, delta, false);
+  while (drop && box->n - (L1 - L0) + k > box->max &&
+         (d = GP_TextBoxDrop(box, ps, &m))) {
+    ps -= d;
+    pe -= d;
+    at -= d;
+    L0 -= m;
+    L1 -= m;
+  }
+
+  /* Lines after the paragraphs touched move to L0 + k. */
+  tail = box->n - L1;
+  t = L0 + k < box->max ? box->max - (L0 + k) : 0;
+  if (tail > t) {
+    tail = t;
+    box->overflow = true;
+  }
+  memmove(box->lines + L0 + k, box->lines + L1, tail * sizeof(GP_TEXT_LINE));
+  for (uint32_t i = L0 + k; i < L0 + k + tail; i++) {
+    box->lines[i].start += delta;
+    box->lines[i].dirty |= k != L1 - L0;
+  }
+  GP_TextBoxFlow(box, ps, pe, L0, L0 + k < L1 ? L0 + k : L1, at, at + slen,
+                 delta, true);
+  if (L0 + k > box->max)
+    box->overflow = true;
+  box->n = L0 + k + tail < box->max ? L0 + k + tail : box->max;
+
+  /* The last lines are shown. */
+  rows = box->heigth / box->f->Heigth;
+  box->first = box->n > rows ? box->n - rows : 0;
+}
+
+void GP_TextBoxInit(GP_TEXT_BOX *box,
+                    uint8_t *chars,
+                    uint16_t size,
+                    GP_TEXT_LINE *lines,
+                    uint16_t max,
+                    const FONT *f,
+                    uint16_t x,
+                    uint16_t y,
+                    uint16_t width,
+                    uint16_t heigth)
+{
+  box->f = f;
+  box->x = x;
+  box->y = y;
+  box->width = width;
+  box->heigth = heigth;
+  box->chars = chars;
+  box->len = 0;
+  box->size = size;
+  box->lines = lines;
+  box->n = max ? 1 : 0;
+  box->max = max;
+  box->first = 0;
+  box->overflow = false;
+  if (max)
+    lines[0] = (GP_TEXT_LINE){0, 0, true};
+  GP_TextBoxInvalidate(box);
+}
+
+void GP_TextBoxAppend(GP_TEXT_BOX *box, const uint8_t *String)
+{
+  GP_TextBoxEdit(box, box->len, 0, String, true);
+}
+
+void GP_TextBoxReplace(GP_TEXT_BOX *box,
+                       uint16_t at,
+                       uint16_t count,
+                       const uint8_t *String)
+{
+  GP_TextBoxEdit(box, at, count, String, false);
+}
+
+void GP_TextBoxInvalidate(GP_TEXT_BOX *box)
+{
+  for (uint32_t i = 0; i < box->n; i++)
+    box->lines[i].dirty = true;
+  box->drawn = box->first;
+  box->drawn_rows = box->f->Heigth ? box->heigth / box->f->Heigth : 0;
+}
+
+/* Moves the pixel rows of the box up by dy, up to its row bottom. */
+static void GP_TextBoxScroll(const GP_TEXT_BOX *box,
+                             uint32_t dy,
+                             uint32_t bottom,
+                             uint16_t *Buffer,
+                             uint32_t w,
+                             uint32_t h)
+{
+  int32_t x1 = box->x, x2 = (int32_t)box->x + box->width - 1;
+
+  if (x2 >= (int32_t)w)
+    x2 = (int32_t)w - 1;
+  if (bottom > h)
+    bottom = h;
+  if (x1 > x2)
+    return;
+  for (uint32_t y = box->y; y + dy < bottom; y++) {
+    int32_t x = GP_IsRotated() ? x2 : x1;
+    memmove(GP_PixelPtr(x, y, Buffer, w, h),
+            GP_PixelPtr(x, y + dy, Buffer, w, h),
+            (x2 - x1 + 1) * sizeof(uint16_t));
+  }
+}
+
+/* Draws line i of the box in its row r. */
+static void GP_TextBoxLine(const GP_TEXT_BOX *box,
+                           uint32_t i,
+                           uint32_t r,
+                           uint16_t color,
+                           uint16_t bg,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h)
+{
+  const FONT *f = box->f;
+  uint32_t y = box->y + r * f->Heigth, right = box->x + box->width;
+  uint32_t x = box->x;
+
+  for (uint32_t k = 0; k < f->Heigth; k++)
+    GP_SetSpanH(box->x, right - 1, y + k, bg, Buffer, w, h);
+  if (i >= box->n)
+    return;
+  for (uint32_t j = 0; j < box->lines[i].len; j++) {
+    uint8_t ch = GP_CharIndex(box->chars[box->lines[i].start + j]);
+    /* Only a char wider than the box can cross its side. */
+    if (x + f->FontChar[ch].width > right || x >= w)
+      break;
+    GP_PutCharTransp(x, y, color, ch, f, Buffer, w, h);
+    x += f->FontChar[ch].width + 2;
+  }
+}
+
+void GP_TextBoxDraw(GP_TEXT_BOX *box,
+                    uint16_t color,
+                    uint16_t bg,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h)
+{
+  uint32_t rows = box->heigth / box->f->Heigth, exposed = rows;
+  uint32_t shown = (uint32_t)box->n - box->first;
+  int32_t shift = (int32_t)box->first - box->drawn;
+
+  if (shown > rows)
+    shown = rows;
+  if (shift > 0 && (uint32_t)shift < rows) {
+    GP_TextBoxScroll(box, shift * box->f->Heigth,
+                     box->y + rows * box->f->Heigth, Buffer, w, h);
+    exposed = rows - shift;
+    box->drawn_rows = rows;
+  } else if (shift) {
+    exposed = 0;
+    box->drawn_rows = rows;
+  }
+
+  for (uint32_t r = 0; r < shown; r++) {
+    GP_TEXT_LINE *l = &box->lines[box->first + r];
+    if (l->dirty || r >= exposed)
+      GP_TextBoxLine(box, box->first + r, r, color, bg, Buffer, w, h);
+    l->dirty = false;
+  }
+  for (uint32_t r = shown; r < box->drawn_rows; r++)
+    GP_TextBoxLine(box, box->n, r, color, bg, Buffer, w, h);
+  box->drawn = box->first;
+  box->drawn_rows = shown;
 }
 
 void BMP_DrawTransp(uint16_t Xpos,
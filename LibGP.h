@@ -212,6 +212,174 @@ void GP_SetBresenhamLine(uint16_t x1,
                          uint32_t w,
                          uint32_t h);
 
+/**
+ *	\brief function draws a line by runs. It sets the same pixels as the
+ *	Bresenham line, but each horizontal (or vertical for steep lines) run
+ *	of pixels is drawn at once.
+ *	\param x1, y1, x2, y2 - a coordinates of the line.
+ *	\param color - color of the line.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetRunSliceLine(uint16_t x1,
+                        uint16_t y1,
+                        uint16_t x2,
+                        uint16_t y2,
+                        uint16_t color,
+                        uint16_t *Buffer,
+                        uint32_t w,
+                        uint32_t h);
+
+#define GP_JOIN_MITER 0
+#define GP_JOIN_BEVEL 1
+#define GP_JOIN_ROUND 2
+
+#define GP_CAP_BUTT 0
+#define GP_CAP_SQUARE 1
+#define GP_CAP_ROUND 2
+
+/**
+ *	\brief function draws a thick line. The line is filled by spans.
+ *	\param x1, y1, x2, y2 - a coordinates of the line.
+ *	\param thickness - width of the line in pixels.
+ *	\param cap - ends of the line (GP_CAP_BUTT, GP_CAP_SQUARE, GP_CAP_ROUND).
+ *	\param color - color of the line.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetThickLine(uint16_t x1,
+                     uint16_t y1,
+                     uint16_t x2,
+                     uint16_t y2,
+                     uint16_t thickness,
+                     uint8_t cap,
+                     uint16_t color,
+                     uint16_t *Buffer,
+                     uint32_t w,
+                     uint32_t h);
+
+/**
+ *	\brief function draws a thick polyline. Segments, joins and caps are
+ *	filled by spans, a polyline with thickness 1 is drawn by run sliced lines.
+ *	\param *x, *y - arrays of coordinates of the polyline vertices.
+ *	\param n - number of the vertices.
+ *	\param thickness - width of the polyline in pixels.
+ *	\param join - joins of segments (GP_JOIN_MITER, GP_JOIN_BEVEL, GP_JOIN_ROUND).
+ *	\param cap - ends of the polyline (GP_CAP_BUTT, GP_CAP_SQUARE, GP_CAP_ROUND).
+ *	\param color - color of the polyline.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetPolyline(const uint16_t *x,
+                    const uint16_t *y,
+                    uint16_t n,
+                    uint16_t thickness,
+                    uint8_t join,
+                    uint8_t cap,
+                    uint16_t color,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h);
+
+/**
+ *	\brief function draws a quadratic Bezier curve. The curve is flattened
+ *	to lines by adaptive forward differencing with GP_CURVE_TOLERANCE.
+ *	\param x0, y0 - a coordinates of start of the curve.
+ *	\param x1, y1 - a coordinates of the control point.
+ *	\param x2, y2 - a coordinates of end of the curve.
+ *	\param color - color of the curve.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetBezierQuad(uint16_t x0,
+                      uint16_t y0,
+                      uint16_t x1,
+                      uint16_t y1,
+                      uint16_t x2,
+                      uint16_t y2,
+                      uint16_t color,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h);
+
+/**
+ *	\brief function draws a cubic Bezier curve. The curve is flattened
+ *	to lines by adaptive forward differencing with GP_CURVE_TOLERANCE.
+ *	\param x0, y0 - a coordinates of start of the curve.
+ *	\param x1, y1, x2, y2 - a coordinates of the control points.
+ *	\param x3, y3 - a coordinates of end of the curve.
+ *	\param color - color of the curve.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetBezierCubic(uint16_t x0,
+                       uint16_t y0,
+                       uint16_t x1,
+                       uint16_t y1,
+                       uint16_t x2,
+                       uint16_t y2,
+                       uint16_t x3,
+                       uint16_t y3,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h);
+
+/**
+ *	\brief function draws a thick quadratic Bezier curve. The flattened
+ *	curve is drawn as a thick polyline with miter joins.
+ *	\param x0, y0, x1, y1, x2, y2 - as GP_SetBezierQuad.
+ *	\param thickness - width of the curve in pixels.
+ *	\param cap - ends of the curve (GP_CAP_BUTT, GP_CAP_SQUARE, GP_CAP_ROUND).
+ *	\param color - color of the curve.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_StrokeBezierQuad(uint16_t x0,
+                         uint16_t y0,
+                         uint16_t x1,
+                         uint16_t y1,
+                         uint16_t x2,
+                         uint16_t y2,
+                         uint16_t thickness,
+                         uint8_t cap,
+                         uint16_t color,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h);
+
+/**
+ *	\brief function draws a thick cubic Bezier curve. The flattened
+ *	curve is drawn as a thick polyline with miter joins.
+ *	\param x0, y0, x1, y1, x2, y2, x3, y3 - as GP_SetBezierCubic.
+ *	\param thickness - width of the curve in pixels.
+ *	\param cap - ends of the curve (GP_CAP_BUTT, GP_CAP_SQUARE, GP_CAP_ROUND).
+ *	\param color - color of the curve.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_StrokeBezierCubic(uint16_t x0,
+                          uint16_t y0,
+                          uint16_t x1,
+                          uint16_t y1,
+                          uint16_t x2,
+                          uint16_t y2,
+                          uint16_t x3,
+                          uint16_t y3,
+                          uint16_t thickness,
+                          uint8_t cap,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h);
+
 /**
  *	\brief function draws Bresenham circle.
  *	\param x0, y0 - a coordinates of center of the Bresenham circle.
@@ -287,11 +455,236 @@ void GP_DrawRoundedFill(int16_t x0,
                         uint32_t h);
 
 /**
- *	\brief function drwaws arc. (not implemented)
- *	\param x0, y0 - a coordinates of arc.
- *	\param a1, a2 - start and end angle of arc.
+ *	\brief function draws an ellipse with axes along x and y.
+ *	\param x0, y0 - a coordinates of center of the ellipse.
+ *	\param rx, ry - horizontal and vertical radius of the ellipse.
+ *	\param color - color of the ellipse.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetEllipse(int16_t x0,
+                   int16_t y0,
+                   int16_t rx,
+                   int16_t ry,
+                   uint16_t color,
+                   uint16_t *Buffer,
+                   uint32_t w,
+                   uint32_t h);
+
+/**
+ *	\brief function draws filled ellipse with axes along x and y.
+ *	\param x0, y0 - a coordinates of center of the ellipse.
+ *	\param rx, ry - horizontal and vertical radius of the ellipse.
+ *	\param color - color of the ellipse.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_DrawFilledEllipse(int16_t x0,
+                          int16_t y0,
+                          int16_t rx,
+                          int16_t ry,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h);
+
+/**
+ *	\brief function fills many rectangles at once. The rectangles are sorted
+ *	by their first band of rows once, then the bands are swept top to bottom;
+ *	overlapping rectangles are drawn in the order of the arrays.
+ *	\param *x, *y - arrays of coordinates of left-up corners of rectangles.
+ *	\param *width, *height - arrays of sizes of rectangles.
+ *	\param *colors - array of colors of rectangles.
+ *	\param n - number of rectangles.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillRects(const uint16_t *x,
+                  const uint16_t *y,
+                  const uint16_t *width,
+                  const uint16_t *height,
+                  const uint16_t *colors,
+                  uint32_t n,
+                  uint16_t *Buffer,
+                  uint32_t w,
+                  uint32_t h);
+
+/**
+ *	\brief function draws many Bresenham lines. The lines are swept by bands
+ *	of rows as in GP_FillRects, each cut to the rows of the band; pixels are
+ *	the same as of GP_SetBresenhamLine called for each line in turn.
+ *	\param *x1, *y1, *x2, *y2 - arrays of coordinates of lines.
+ *	\param *colors - array of colors of lines.
+ *	\param n - number of lines.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetLines(const uint16_t *x1,
+                 const uint16_t *y1,
+                 const uint16_t *x2,
+                 const uint16_t *y2,
+                 const uint16_t *colors,
+                 uint32_t n,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h);
+
+/**
+ *	\brief function draws many pixels. A convenience wrapper: only the screen
+ *	rotation is checked once, the pixels are written one by one.
+ *	\param *x, *y - arrays of coordinates of pixels.
+ *	\param *colors - array of colors of pixels.
+ *	\param n - number of pixels.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_SetPixels(const uint16_t *x,
+                  const uint16_t *y,
+                  const uint16_t *colors,
+                  uint32_t n,
+                  uint16_t *Buffer,
+                  uint32_t w,
+                  uint32_t h);
+
+/**
+ *	\brief function draws many filled circles. The circles are swept by bands
+ *	of rows as in GP_FillRects; pixels are the same as of GP_DrawFilledCircle
+ *	called for each circle in turn.
+ *	\param *x, *y - arrays of coordinates of centers of circles.
+ *	\param *r - array of radiuses of circles.
+ *	\param *colors - array of colors of circles.
+ *	\param n - number of circles.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_DrawFilledCircles(const uint16_t *x,
+                          const uint16_t *y,
+                          const uint16_t *r,
+                          const uint16_t *colors,
+                          uint32_t n,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h);
+
+/**
+ *	\brief function plots a time series. Samples are reduced to a min/max
+ *	envelope per pixel column, the result is the same as Bresenham lines
+ *	drawn between all neighbouring samples.
+ *	\param x, y - a coordinates of left-up corner of the plot.
+ *	\param width, heigth - size of the plot.
+ *	\param *Samples - array of samples, sample i is placed at column
+ *	x + i * width / n.
+ *	\param n - number of samples.
+ *	\param min, max - values at the bottom and the top of the plot.
+ *	\param color - color of the plot.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_PlotTimeSeries(uint16_t x,
+                       uint16_t y,
+                       uint16_t width,
+                       uint16_t heigth,
+                       const int16_t *Samples,
+                       uint32_t n,
+                       int16_t min,
+                       int16_t max,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h);
+
+/**
+ *	\brief function draws an anti-aliased filled circle. Only edge pixels
+ *	are blended, the inner part of each row is filled by a span.
+ *	\param x0, y0 - a coordinates of center of the circle.
+ *	\param r - radius of the circle.
+ *	\param color - color of the circle.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_DrawFilledCircleAA(int16_t x0,
+                           int16_t y0,
+                           int16_t r,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h);
+
+/**
+ *	\brief function draws an anti-aliased ring.
+ *	\param x0, y0 - a coordinates of center of the ring.
+ *	\param r_outer, r_inner - outer and inner radiuses of the ring, a ring
+ *	with equal radiuses is an one pixel circle.
+ *	\param color - color of the ring.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_DrawRingAA(int16_t x0,
+                   int16_t y0,
+                   int16_t r_outer,
+                   int16_t r_inner,
+                   uint16_t color,
+                   uint16_t *Buffer,
+                   uint32_t w,
+                   uint32_t h);
+
+/**
+ *	\brief function draws an anti-aliased rounded fill.
+ *	\param x0, y0 - a coordinates of center of the rounded fill.
+ *	\param width and heigth - witdth and heigth of the rounded fill.
+ * 	\param r - radius of roundings of the rounded fill.
+ *	\param color - color of the rounded fill.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_DrawRoundedFillAA(int16_t x0,
+                          int16_t y0,
+                          int16_t width,
+                          int16_t high,
+                          int16_t r,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h);
+
+/**
+ *	\brief function draws an anti-aliased rounded rectangular.
+ *	\param x0, y0 - a coordinates of center of the rounded rectangular.
+ *	\param width and heigth - witdth and heigth of the rounded rectangular.
+ * 	\param r - rounding radius of the rectangular.
+ *	\param color - color of the rounded rectangular.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_RoundedRectAA(int16_t x0,
+                      int16_t y0,
+                      int16_t width,
+                      int16_t heigth,
+                      int16_t r,
+                      uint16_t color,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h);
+
+/**
+ *	\brief function drwaws arc. The arc is a part of GP_SetBresenhamCircle
+ *	going counterclockwise from a1 to a2.
+ *	\param x0, y0 - a coordinates of center of arc.
+ *	\param a1, a2 - start and end angle of arc in degrees, 0 is the east,
+ *	90 is the north. a2 >= a1 + 360 draws the whole circle.
  * 	\param r - radius of arc.
- *	\param color - color of square.
+ *	\param color - color of arc.
  *	\param *Buffer - a pointer to a video buffer.
  *	\params w, h width and height of the video buffer.
  *	\return no.
@@ -306,6 +699,59 @@ void GP_SetArc(uint16_t x,
                uint32_t w,
                uint32_t h);
 
+/**
+ *	\brief function fills a segment of a ring (a thick arc, e.g. for a gauge)
+ *	going counterclockwise from a1 to a2.
+ *	\param x, y - a coordinates of center of ring.
+ *	\param r_inner, r_outer - inner and outer radius, r_inner = 0 gives
+ *	a pie slice.
+ *	\param a1, a2 - start and end angle in degrees, 0 is the east, 90 is the
+ *	north. a2 >= a1 + 360 fills the whole ring.
+ *	\param aa - true to smooth the edges.
+ *	\param color - color of segment.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillArcSegment(uint16_t x,
+                       uint16_t y,
+                       uint16_t r_inner,
+                       uint16_t r_outer,
+                       uint16_t a1,
+                       uint16_t a2,
+                       bool aa,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h);
+
+/**
+ *	\brief function fills a pie (or a donut) chart in one pass over its rows.
+ *	Slices go counterclockwise, slice i takes values[i] of the sum of values.
+ *	\param x, y - a coordinates of center of pie.
+ *	\param r_inner, r_outer - inner and outer radius, r_inner > 0 gives
+ *	a donut.
+ *	\param start - angle of the first slice in degrees, 0 is the east,
+ *	90 is the north.
+ *	\param *values - a pointer to the n slice values.
+ *	\param *colors - a pointer to the n slice colors.
+ *	\param n - number of slices.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillPie(uint16_t x,
+                uint16_t y,
+                uint16_t r_inner,
+                uint16_t r_outer,
+                uint16_t start,
+                const uint16_t *values,
+                const uint16_t *colors,
+                uint32_t n,
+                uint16_t *Buffer,
+                uint32_t w,
+                uint32_t h);
+
 #define GP_NORTH 1
 #define GP_SOUTH 2
 #define GP_WEST 3
@@ -360,17 +806,373 @@ void GP_PutArrow(uint16_t x,
                  uint32_t w,
                  uint32_t h);
 
+/**
+ *	\brief function draws a filled triangle, the filled GP_PutTriangle.
+ *	\param x, y coordinates of center of the triangle.
+ *	\param heigth, width - external size of the triangle.
+ *	\param side - direction of the triangle.
+ *	\param color - color of the triangle.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_PutFilledTriangle(uint16_t x,
+                          uint16_t y,
+                          uint16_t width,
+                          uint16_t heigth,
+                          uint8_t side,
+                          uint16_t color,
+                          uint16_t *Buffer,
+                          uint32_t w,
+                          uint32_t h);
+
+/**
+ *	\brief function draws a filled arrow, the filled GP_PutArrow.
+ *	\param x, y coordinates of center of the arrow.
+ *	\param heigth, width - external size of the arrow.
+ *	\param side - direction of the arrow.
+ *	\param color - color of the arrow.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_PutFilledArrow(uint16_t x,
+                       uint16_t y,
+                       uint16_t width,
+                       uint16_t heigth,
+                       uint8_t side,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h);
+
+#define GP_FILL_EVEN_ODD 0
+#define GP_FILL_NON_ZERO 1
+
+/**
+ *	\brief function fills a polygon. Pixels whose centers are inside are
+ *	filled, the polygon may be concave or self-intersecting.
+ *	\param *x, *y - a pointers to the n vertex coordinates, the last vertex
+ *	is connected to the first one.
+ *	\param n - number of vertices, 3..256.
+ *	\param rule - GP_FILL_EVEN_ODD or GP_FILL_NON_ZERO.
+ *	\param color - color of the polygon.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillPolygon(const uint16_t *x,
+                    const uint16_t *y,
+                    uint16_t n,
+                    uint8_t rule,
+                    uint16_t color,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h);
+
+/**
+ *	\brief function fills a mesh of triangles, e.g. map layers. Pixel
+ *	(i, j) is filled when the point (16 * i, 16 * j) is inside a triangle,
+ *	pixels on an edge shared by two triangles are filled once (top-left
+ *	rule). Overlapping triangles look as drawn one by one.
+ *	\param *x, *y - a pointers to vertex coordinates in 1/16 of a pixel.
+ *	\param *index - a pointer to 3 * n vertex indexes, three per triangle.
+ *	\param *colors - a pointer to the n triangle colors.
+ *	\param n - number of triangles.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillTriangles(const int16_t *x,
+                      const int16_t *y,
+                      const uint16_t *index,
+                      const uint16_t *colors,
+                      uint32_t n,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h);
+
+/**
+ *	\brief function fills a triangle with colors of its vertices smoothly
+ *	mixed (Gouraud shading), dithered to RGB565. Pixels are covered as by
+ *	GP_FillTriangles.
+ *	\param *x, *y - a pointers to the 3 vertex coordinates in 1/16 of
+ *	a pixel.
+ *	\param *colors - a pointer to the 3 vertex colors as 0xRRGGBB.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillShadedTriangle(const int16_t *x,
+                           const int16_t *y,
+                           const uint32_t *colors,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h);
+
+/**
+ *	\brief Point of a path, in 1/256 of a pixel.
+ */
+typedef struct gp_path_point
+{
+  int32_t x, y;
+  uint8_t move;   /**< 1 when the point starts a contour. */
+} GP_PATH_POINT;
+
+/**
+ *	\brief Path of contours made of lines and curves, flattened into storage
+ *	given by the caller.
+ */
+typedef struct gp_path
+{
+  GP_PATH_POINT *points;  /**< Point storage. */
+  uint16_t n;             /**< Points used. */
+  uint16_t max;           /**< Size of the point storage. */
+  uint16_t start;         /**< First point of the current contour. */
+  bool closed;            /**< The current contour is closed. */
+  bool overflow;          /**< Some points did not fit in the storage. */
+} GP_PATH;
+
+/**
+ *	\brief function prepares an empty path.
+ *	\param *path - a pointer to the path.
+ *	\param *points - a pointer to storage for max points. Each line takes
+ *	a point, curves take a point per flattened piece.
+ *	\param max - size of the point storage.
+ *	\return no.
+ */
+void GP_PathInit(GP_PATH *path, GP_PATH_POINT *points, uint16_t max);
+
+/**
+ *	\brief function starts a new contour of a path.
+ *	\param *path - a pointer to the path.
+ *	\param x, y - start of the contour in 1/16 of a pixel.
+ *	\return no.
+ */
+void GP_PathMoveTo(GP_PATH *path, int32_t x, int32_t y);
+
+/**
+ *	\brief function adds a line to a path.
+ *	\param *path - a pointer to the path.
+ *	\param x, y - end of the line in 1/16 of a pixel.
+ *	\return no.
+ */
+void GP_PathLineTo(GP_PATH *path, int32_t x, int32_t y);
+
+/**
+ *	\brief function adds a quadratic Bezier curve to a path.
+ *	\param *path - a pointer to the path.
+ *	\param cx, cy - control point in 1/16 of a pixel.
+ *	\param x, y - end of the curve in 1/16 of a pixel.
+ *	\return no.
+ */
+void GP_PathQuadTo(GP_PATH *path, int32_t cx, int32_t cy, int32_t x, int32_t y);
+
+/**
+ *	\brief function adds a cubic Bezier curve to a path.
+ *	\param *path - a pointer to the path.
+ *	\param cx1, cy1, cx2, cy2 - control points in 1/16 of a pixel.
+ *	\param x, y - end of the curve in 1/16 of a pixel.
+ *	\return no.
+ */
+void GP_PathCubicTo(GP_PATH *path,
+                    int32_t cx1,
+                    int32_t cy1,
+                    int32_t cx2,
+                    int32_t cy2,
+                    int32_t x,
+                    int32_t y);
+
+/**
+ *	\brief function closes the current contour of a path by a line to its
+ *	start.
+ *	\param *path - a pointer to the path.
+ *	\return no.
+ */
+void GP_PathClose(GP_PATH *path);
+
+/**
+ *	\brief function fills a path with anti-aliased edges. Open contours are
+ *	filled as closed.
+ *	\param *path - a pointer to the path.
+ *	\param rule - GP_FILL_EVEN_ODD or GP_FILL_NON_ZERO.
+ *	\param color - color of the path.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillPath(const GP_PATH *path,
+                 uint8_t rule,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h);
+
+/**
+ *	\brief function fills an anti-aliased rounded rectangle of any size from
+ *	its signed distance.
+ *	\param x, y - center of the rectangle in 1/16 of a pixel.
+ *	\param width, heigth - size of the rectangle in 1/16 of a pixel.
+ *	\param r - radius of the corners in 1/16 of a pixel.
+ *	\param color - color of the rectangle.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillRoundedRectSDF(int32_t x,
+                           int32_t y,
+                           int32_t width,
+                           int32_t heigth,
+                           int32_t r,
+                           uint16_t color,
+                           uint16_t *Buffer,
+                           uint32_t w,
+                           uint32_t h);
+
+/**
+ *	\brief function fills an anti-aliased circle of any size from its signed
+ *	distance.
+ *	\param x, y - center of the circle in 1/16 of a pixel.
+ *	\param r - radius of the circle in 1/16 of a pixel.
+ *	\param color - color of the circle.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillCircleSDF(int32_t x,
+                      int32_t y,
+                      int32_t r,
+                      uint16_t color,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h);
+
+/**
+ *	\brief function fills an anti-aliased capsule (a line with round ends)
+ *	from its signed distance.
+ *	\param x1, y1, x2, y2 - ends of the line in 1/16 of a pixel.
+ *	\param r - half of the thickness in 1/16 of a pixel.
+ *	\param color - color of the capsule.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_FillCapsuleSDF(int32_t x1,
+                       int32_t y1,
+                       int32_t x2,
+                       int32_t y2,
+                       int32_t r,
+                       uint16_t color,
+                       uint16_t *Buffer,
+                       uint32_t w,
+                       uint32_t h);
+
+#define GP_SHAPE_ARROW 0           /**< GP_PutArrow. */
+#define GP_SHAPE_FILLED_ARROW 1    /**< GP_PutFilledArrow. */
+#define GP_SHAPE_TRIANGLE 2        /**< GP_PutTriangle. */
+#define GP_SHAPE_FILLED_TRIANGLE 3 /**< GP_PutFilledTriangle. */
+#define GP_SHAPE_CROSS 4           /**< GP_SetCross. */
+#define GP_SHAPE_CIRCLE 5          /**< GP_SetBresenhamCircle. */
+#define GP_SHAPE_FILLED_CIRCLE 6   /**< GP_DrawFilledCircle. */
+
+/**
+ *	\brief function draws a shape from a cache of masks. The first draw of a
+ *	shape rasterizes it, later draws of the same shape blit its mask in any
+ *	color. The least recently used masks are dropped when the cache is full.
+ *	Shapes larger than 64 pixels are drawn directly.
+ *	\param shape - one of GP_SHAPE_.
+ *	\param x, y - coordinates of center of the shape.
+ *	\param width, heigth - size of the shape as in its function. Circles take
+ *	the radius in width, the cross takes width only.
+ *	\param side - direction of arrows and triangles.
+ *	\param aa - anti-aliased edges, for circles and filled arrows and
+ *	triangles.
+ *	\param color - color of the shape.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_PutShape(uint8_t shape,
+                 uint16_t x,
+                 uint16_t y,
+                 uint16_t width,
+                 uint16_t heigth,
+                 uint8_t side,
+                 bool aa,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h);
+
+/**
+ *	\brief function reports the use of the shape cache.
+ *	\param *hits - draws from a cached mask.
+ *	\param *misses - draws that rasterized the shape.
+ *	\return no.
+ */
+void GP_ShapeCacheStats(uint32_t *hits, uint32_t *misses);
+
+/**
+ *	\brief function drops every cached shape and resets the counters.
+ *	\return no.
+ */
+void GP_ShapeCacheClear(void);
+
+/**
+ *	\brief Pending span of a flood fill.
+ */
+typedef struct gp_flood_span
+{
+  int32_t y, x1, x2, dy;
+} GP_FLOOD_SPAN;
+
+/**
+ *	\brief Storage of a flood fill given by the caller: a stack of pending
+ *	spans and a bitmap with a bit per pixel of the filling area.
+ */
+typedef struct gp_flood_fill
+{
+  GP_FLOOD_SPAN *spans;   /**< Span storage. */
+  uint32_t max;           /**< Size of the span storage. */
+  uint32_t *marks;        /**< Mark storage. */
+  uint32_t size;          /**< Size of the mark storage in words. */
+} GP_FLOOD_FILL;
+
+/** Words of mark storage for a filling area of width x heigth. */
+#define GP_FLOOD_MARK_WORDS(width, heigth) \
+  (((uint32_t)(width) * (uint32_t)(heigth) + 31) / 32)
+
+/**
+ *	\brief function prepares the storage of flood fills.
+ *	\param *fill - a pointer to the fill storage.
+ *	\param *spans - a pointer to storage for max spans. Any number works, a
+ *	few hundred spans are seldom filled; spans that do not fit are found
+ *	again from the marks, at the cost of a scan of the area.
+ *	\param max - size of the span storage.
+ *	\param *marks - a pointer to storage for size words, at least
+ *	GP_FLOOD_MARK_WORDS(width, heigth) of the largest filling area.
+ *	\param size - size of the mark storage.
+ *	\return no.
+ */
+void GP_FloodFillInit(GP_FLOOD_FILL *fill,
+                      GP_FLOOD_SPAN *spans,
+                      uint32_t max,
+                      uint32_t *marks,
+                      uint32_t size);
+
 /**
  *	\brief a flood fill function. Fills an area bounded by closed lines.
- *	\param x, y - coordinates of center a center of filling area.
- *	\param heigth, width - maximum rectangular size of the filling area. It should be greater than area bounded by closed lines.
+ *	\param *fill - a pointer to the fill storage.
+ *	\param x, y - coordinates of a point inside the filling area.
+ *	\param heigth, width - maximum rectangular size of the filling area around x, y. The fill stops at its sides.
+ *	\param color - a color of the filling. Pixels of this color bound the area too.
  *	\param border_color - a color of the closed lines (border) that bounds the area.
  *  \param *Buffer - a pointer to a video buffer.
  *  \param w, h - width and height of the video buffer
- *	\return - no.
- *  \status not works well yet.!
+ *	\return - false when the storage is too small for the filling area, nothing is drawn then.
  */
-void GP_FillArea(uint16_t x,
+bool GP_FillArea(GP_FLOOD_FILL *fill,
+                 uint16_t x,
                  uint16_t y,
                  uint16_t heigth,
                  uint16_t width,
@@ -397,6 +1199,41 @@ void GP_PutChar(uint16_t x,
                 uint32_t h,
                 unsigned cbc);
 
+/**
+ *	\brief function prints a char without its background.
+ *	\param x, y - coordinates of left-up corner of the char.
+ *	\param color - color of char.
+ *	\param Ch - index of the char in the font.
+ *	\param *f - a pointer to the font.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_PutCharTransp(uint16_t x,
+                      uint16_t y,
+                      uint16_t color,
+                      const uint8_t Ch,
+                      const FONT *f,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h);
+
+/**
+ *	\brief function reports the use of the glyph cache of GP_PutChar and
+ *	GP_PutCharTransp.
+ *	\param *hits - glyphs drawn from the cache.
+ *	\param *misses - glyphs that were added to the cache.
+ *	\return no.
+ */
+void GP_GlyphCacheStats(uint32_t *hits, uint32_t *misses);
+
+/**
+ *	\brief function drops every cached glyph and resets the counters. Call it
+ *	when a font bitmap is changed.
+ *	\return no.
+ */
+void GP_GlyphCacheClear(void);
+
 /**
  *	\brief - function prints a string.
  *	\param  - .
@@ -431,6 +1268,268 @@ void GP_PutStringInTheCenter(uint16_t x,
                              uint32_t h,
                              unsigned cbc);
 
+#define GP_ALIGN_LEFT 0x00     /**< x is the left side of the text. */
+#define GP_ALIGN_CENTER 0x01   /**< x is the middle of the text. */
+#define GP_ALIGN_RIGHT 0x02    /**< x is the right side of the text. */
+#define GP_ALIGN_HMASK 0x03
+#define GP_ALIGN_TOP 0x00      /**< y is the top of the font. */
+#define GP_ALIGN_MIDDLE 0x04   /**< y is the middle of the font. */
+#define GP_ALIGN_BOTTOM 0x08   /**< y is the bottom of the font. */
+#define GP_ALIGN_BASELINE 0x0C /**< y is the baseline of the font. */
+#define GP_ALIGN_VMASK 0x0C
+
+/**
+ *	\brief function prints a string aligned around a point.
+ *	\param x, y - coordinates of the point.
+ *	\param align - a horizontal GP_ALIGN_LEFT, GP_ALIGN_CENTER or
+ *	GP_ALIGN_RIGHT combined with a vertical GP_ALIGN_TOP, GP_ALIGN_MIDDLE,
+ *	GP_ALIGN_BOTTOM or GP_ALIGN_BASELINE.
+ *	\param color - color of the string.
+ *	\param *String - a pointer to the string.
+ *	\param *f - a pointer to the font.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\param cbc - the background is black when not 0, else the color under
+ *	the string.
+ *	\return no.
+ */
+void GP_PutStringAligned(int16_t x,
+                         int16_t y,
+                         uint8_t align,
+                         uint16_t color,
+                         const uint8_t *String,
+                         const FONT *f,
+                         uint16_t *Buffer,
+                         uint32_t w,
+                         uint32_t h,
+                         unsigned cbc);
+
+/**
+ *	\brief function prints a UTF-8 string aligned around a point. Chars the
+ *	font has no glyph for are printed as '?'.
+ *	\param x, y - coordinates of the point.
+ *	\param align - alignment as for GP_PutStringAligned.
+ *	\param color - color of the string.
+ *	\param *String - a pointer to the UTF-8 string.
+ *	\param *f - a pointer to the font.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\param cbc - the background is black when not 0, else the color under
+ *	the string.
+ *	\return no.
+ */
+void GP_PutStringUTF8(int16_t x,
+                      int16_t y,
+                      uint8_t align,
+                      uint16_t color,
+                      const uint8_t *String,
+                      const FONT *f,
+                      uint16_t *Buffer,
+                      uint32_t w,
+                      uint32_t h,
+                      unsigned cbc);
+
+/**
+ *	\brief function measures a string as GP_PutString lays it out.
+ *	\param *String - a pointer to the string.
+ *	\param *f - a pointer to the font.
+ *	\return width of the string in pixels.
+ */
+uint16_t GP_MeasureString(const uint8_t *String, const FONT *f);
+
+/**
+ *	\brief function measures a UTF-8 string as GP_PutStringUTF8 lays it out.
+ *	\param *String - a pointer to the UTF-8 string.
+ *	\param *f - a pointer to the font.
+ *	\return width of the string in pixels.
+ */
+uint16_t GP_MeasureStringUTF8(const uint8_t *String, const FONT *f);
+
+/**
+ *	\brief function finds the glyph of a codepoint by the ranges of a font.
+ *	Fonts without ranges have the CP1251 layout of GP_PutString.
+ *	\param *f - a pointer to the font.
+ *	\param cp - the codepoint.
+ *	\return index of the glyph in the font, -1 if the font has none.
+ */
+int32_t GP_FontGlyph(const FONT *f, uint32_t cp);
+
+/**
+ *	\brief Glyph of a laid out text.
+ */
+typedef struct gp_text_glyph
+{
+  uint16_t x;   /**< Pixels from the left side of the text. */
+  uint16_t ch;  /**< Index of the glyph in the font. */
+} GP_TEXT_GLYPH;
+
+/**
+ *	\brief Text laid out once to be drawn any number of times, in glyph
+ *	storage given by the caller.
+ */
+typedef struct gp_text
+{
+  const FONT *f;          /**< Font of the text. */
+  GP_TEXT_GLYPH *glyphs;  /**< Glyph storage. */
+  uint16_t n;             /**< Glyphs used. */
+  uint16_t max;           /**< Size of the glyph storage. */
+  uint16_t width;         /**< Width of the text in pixels. */
+  uint8_t baseline;       /**< Rows from the top of the font to its baseline. */
+  bool overflow;          /**< Some chars did not fit in the storage. */
+} GP_TEXT;
+
+/**
+ *	\brief function prepares an empty text.
+ *	\param *text - a pointer to the text.
+ *	\param *glyphs - a pointer to storage for max glyphs, one per char.
+ *	\param max - size of the glyph storage.
+ *	\return no.
+ */
+void GP_TextInit(GP_TEXT *text, GP_TEXT_GLYPH *glyphs, uint16_t max);
+
+/**
+ *	\brief function lays out a string in a text, replacing what it held.
+ *	\param *text - a pointer to the text.
+ *	\param *String - a pointer to the string.
+ *	\param *f - a pointer to the font.
+ *	\return no.
+ */
+void GP_TextLayout(GP_TEXT *text, const uint8_t *String, const FONT *f);
+
+/**
+ *	\brief function lays out a UTF-8 string in a text, replacing what it
+ *	held.
+ *	\param *text - a pointer to the text.
+ *	\param *String - a pointer to the UTF-8 string.
+ *	\param *f - a pointer to the font.
+ *	\return no.
+ */
+void GP_TextLayoutUTF8(GP_TEXT *text, const uint8_t *String, const FONT *f);
+
+/**
+ *	\brief function draws a laid out text aligned around a point.
+ *	\param *text - a pointer to the text.
+ *	\param x, y - coordinates of the point.
+ *	\param align - alignment as for GP_PutStringAligned.
+ *	\param color - color of the text.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\param cbc - the background is black when not 0, else the color under
+ *	the text.
+ *	\return no.
+ */
+void GP_DrawText(const GP_TEXT *text,
+                 int16_t x,
+                 int16_t y,
+                 uint8_t align,
+                 uint16_t color,
+                 uint16_t *Buffer,
+                 uint32_t w,
+                 uint32_t h,
+                 unsigned cbc);
+
+/**
+ *	\brief Line of a text box.
+ */
+typedef struct gp_text_line
+{
+  uint16_t start;   /**< First char of the line. */
+  uint16_t len;     /**< Chars of the line. */
+  bool dirty;       /**< Changed since the box was drawn. */
+} GP_TEXT_LINE;
+
+/**
+ *	\brief Box of word wrapped text, in char and line storage given by the
+ *	caller. Paragraphs are ended by '\n', the last lines are shown.
+ */
+typedef struct gp_text_box
+{
+  const FONT *f;          /**< Font of the text. */
+  uint16_t x, y;          /**< Left-up corner of the box. */
+  uint16_t width, heigth; /**< Size of the box. */
+  uint8_t *chars;         /**< Char storage. */
+  uint16_t len;           /**< Chars used. */
+  uint16_t size;          /**< Size of the char storage. */
+  GP_TEXT_LINE *lines;    /**< Line storage. */
+  uint16_t n;             /**< Lines used. */
+  uint16_t max;           /**< Size of the line storage. */
+  uint16_t first;         /**< First line shown. */
+  int32_t drawn;          /**< First line shown by the last draw. */
+  uint16_t drawn_rows;    /**< Rows of the box the last draw filled. */
+  bool overflow;          /**< Some text did not fit in the storage. */
+} GP_TEXT_BOX;
+
+/**
+ *	\brief function prepares an empty text box.
+ *	\param *box - a pointer to the text box.
+ *	\param *chars - a pointer to storage for size chars.
+ *	\param size - size of the char storage.
+ *	\param *lines - a pointer to storage for max lines. size + 1 lines are
+ *	never too few.
+ *	\param max - size of the line storage.
+ *	\param *f - a pointer to the font.
+ *	\param x, y - coordinates of left-up corner of the box.
+ *	\param width, heigth - size of the box.
+ *	\return no.
+ */
+void GP_TextBoxInit(GP_TEXT_BOX *box,
+                    uint8_t *chars,
+                    uint16_t size,
+                    GP_TEXT_LINE *lines,
+                    uint16_t max,
+                    const FONT *f,
+                    uint16_t x,
+                    uint16_t y,
+                    uint16_t width,
+                    uint16_t heigth);
+
+/**
+ *	\brief function adds a string to the end of a text box. The first
+ *	paragraphs are dropped when the storage is full.
+ *	\param *box - a pointer to the text box.
+ *	\param *String - a pointer to the string, '\n' ends a paragraph.
+ *	\return no.
+ */
+void GP_TextBoxAppend(GP_TEXT_BOX *box, const uint8_t *String);
+
+/**
+ *	\brief function replaces chars of a text box by a string.
+ *	\param *box - a pointer to the text box.
+ *	\param at - the first char replaced.
+ *	\param count - chars replaced, 0 inserts the string at at.
+ *	\param *String - a pointer to the string, '\n' ends a paragraph.
+ *	\return no.
+ */
+void GP_TextBoxReplace(GP_TEXT_BOX *box,
+                       uint16_t at,
+                       uint16_t count,
+                       const uint8_t *String);
+
+/**
+ *	\brief function makes the next GP_TextBoxDraw draw the whole box, as
+ *	when the screen under it was changed.
+ *	\param *box - a pointer to the text box.
+ *	\return no.
+ */
+void GP_TextBoxInvalidate(GP_TEXT_BOX *box);
+
+/**
+ *	\brief function draws the lines of a text box changed since it was last
+ *	drawn, clipped to the box.
+ *	\param *box - a pointer to the text box.
+ *	\param color - color of the text.
+ *	\param bg - color of the box.
+ *	\param *Buffer - a pointer to a video buffer.
+ *	\params w, h width and height of the video buffer.
+ *	\return no.
+ */
+void GP_TextBoxDraw(GP_TEXT_BOX *box,
+                    uint16_t color,
+                    uint16_t bg,
+                    uint16_t *Buffer,
+                    uint32_t w,
+                    uint32_t h);
+
 /**
  *	\brief function draws a bitmaps.
  *	\param  - x, y - coordinates of center of the bitmap.